@@ -0,0 +1,921 @@
+#include <confetti/confetti.hpp>
+#include <confetti/image.hpp>
+#include <confetti/uring.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define CONFETTI_BENCH_CYCLES 1
+#elif defined(_MSC_VER)
+#include <intrin.h>
+#define CONFETTI_BENCH_CYCLES 1
+#endif
+
+
+namespace {
+
+    struct measure {
+        double seconds;
+        double cycles;
+    }; // measure
+
+
+    template<typename F> measure best_of(int runs, F&& f) {
+        measure best{1e300, 1e300};
+        for(int i = 0; i != runs; ++i) {
+            auto const started = std::chrono::steady_clock::now();
+#if CONFETTI_BENCH_CYCLES
+            auto const started_cycles = __rdtsc();
+#endif
+            f();
+#if CONFETTI_BENCH_CYCLES
+            double const cycles = double(__rdtsc() - started_cycles);
+#else
+            double const cycles = 0.;
+#endif
+            std::chrono::duration<double> const elapsed =
+                std::chrono::steady_clock::now() - started;
+            if(elapsed.count() < best.seconds)
+                best = measure{elapsed.count(), cycles};
+        }
+        return best;
+    }
+
+
+    void report(char const* name, std::size_t bytes, measure const& m) {
+        std::printf("%-40s %8.3f GB/s", name, double(bytes) / m.seconds / 1e9);
+        if(m.cycles > 0.)
+            std::printf(" %7.3f bytes/cycle", double(bytes) / m.cycles);
+        std::printf("\n");
+    }
+
+
+    void report_latency(char const* name, std::size_t operations,
+                        measure const& m) {
+        std::printf("%-40s %8.2f ns/op", name,
+                    m.seconds * 1e9 / double(operations));
+        if(m.cycles > 0.)
+            std::printf(" %8.1f cycles/op", m.cycles / double(operations));
+        std::printf("\n");
+    }
+
+
+    // Keeps result observable for optimizer
+    volatile std::size_t sink;
+
+
+    std::string make_config(std::size_t sections) {
+        std::string text;
+        for(std::size_t i = 0; i != sections; ++i) {
+            text += "# Generated section " + std::to_string(i)
+                  + ", do not edit by hand: any change will be overwritten"
+                    " on next rebuild of instrument tables\n";
+            text += "[section" + std::to_string(i) + "]\n";
+            text += "name = \"instrument " + std::to_string(i)
+                  + " with rather long quoted description of its purpose\"\n";
+            text += "threads = " + std::to_string(i % 64) + "\n";
+            text += "ratio = 0." + std::to_string(i) + "\n";
+            text += "; trailing comment that is a bit shorter than first one\n";
+            text += "tags = ['alpha', 'beta', 'gamma', 'delta']\n";
+        }
+        text.append(confetti::detail::source_padding, '\0');
+        return text;
+    }
+
+
+    template<typename F>
+    std::size_t skip_lines(std::string const& text, F find_line_end) {
+        std::size_t lines = 0;
+        char const* cursor = text.data();
+        for(;;) {
+            cursor = find_line_end(cursor);
+            if(*cursor == '\0')
+                return lines;
+            ++cursor;
+            ++lines;
+        }
+    }
+
+
+    template<typename F>
+    std::size_t skip_strings(std::string const& text, F find_string_end) {
+        std::size_t quotes = 0;
+        char const* cursor = text.data();
+        for(;;) {
+            cursor = find_string_end(cursor);
+            if(*cursor == '\0')
+                return quotes;
+            ++cursor;
+            ++quotes;
+        }
+    }
+
+
+    template<typename F>
+    std::size_t skip_words(std::string const& text, F find_word_end) {
+        std::size_t words = 0;
+        char const* cursor = text.data();
+        for(;;) {
+            cursor = find_word_end(cursor);
+            if(*cursor == '\0')
+                return words;
+            while(*cursor != '\0'
+                  && confetti::detail::scalar::find_word_end(cursor) == cursor)
+                ++cursor;
+            ++words;
+        }
+    }
+
+
+    template<typename Scaner>
+    std::size_t scan_tokens_with(std::string const& text) {
+        std::string copy = text;
+        Scaner scaner{copy.data()};
+        std::size_t tokens = 0;
+        while(scaner.next() != confetti::detail::token::end)
+            ++tokens;
+        return tokens;
+    }
+
+
+    void bench_scaner() {
+        using namespace confetti::detail;
+        std::string const text = make_config(100000);
+        std::size_t const bytes = text.size() - source_padding;
+
+        report("line end (scalar)", bytes, best_of(5, [&] {
+            sink = skip_lines(text, scalar::find_line_end);
+        }));
+        report("line end (vectorized)", bytes, best_of(5, [&] {
+            sink = skip_lines(text, find_line_end);
+        }));
+        report("string end (scalar)", bytes, best_of(5, [&] {
+            sink = skip_strings(text, scalar::find_string_end<'"'>);
+        }));
+        report("string end (vectorized)", bytes, best_of(5, [&] {
+            sink = skip_strings(text, find_string_end<'"'>);
+        }));
+        report("word end (scalar)", bytes, best_of(5, [&] {
+            sink = skip_words(text, scalar::find_word_end);
+        }));
+        report("word end (vectorized)", bytes, best_of(5, [&] {
+            sink = skip_words(text, find_word_end);
+        }));
+        report("scaner tokens", bytes, best_of(5, [&] {
+            sink = scan_tokens_with<scaner>(text);
+        }));
+        report("parse_text", bytes, best_of(5, [&] {
+            sink = confetti::parse_text(text.data()).config.size();
+        }));
+    }
+
+
+    void bench_engines() {
+        using namespace confetti::detail;
+        std::string const text = make_config(100000);
+        std::size_t const bytes = text.size() - source_padding;
+
+        report("tokens (scaner)", bytes, best_of(5, [&] {
+            sink = scan_tokens_with<scaner>(text);
+        }));
+        report("tokens (indexed scaner)", bytes, best_of(5, [&] {
+            sink = scan_tokens_with<indexed_scaner>(text);
+        }));
+        report("parse_text (standard)", bytes, best_of(5, [&] {
+            sink = confetti::parse_text(text.data()).config.size();
+        }));
+        report("parse_text (indexed)", bytes, best_of(5, [&] {
+            sink = confetti::parse_text(text.data(), confetti::mode::indexed)
+                       .config.size();
+        }));
+    }
+
+
+    void bench_tables() {
+        for(std::size_t const n: {5, 20, 50, 200}) {
+            std::string text = "[section]\n";
+            std::vector<std::string> keys;
+            for(std::size_t i = 0; i != n; ++i) {
+                keys.push_back("parameter_" + std::to_string(i * 7919));
+                text += keys.back() + " = " + std::to_string(i) + "\n";
+            }
+            confetti::result parsed = confetti::parse_text(text.data());
+            confetti::value& section = *parsed.config.find("section");
+            std::unordered_map<std::string_view, int> map;
+            for(auto const& key: keys)
+                map.emplace(key, 0);
+
+            std::size_t const rounds = 1000000 / n;
+            std::size_t const lookups = rounds * n;
+            char name[64];
+            std::snprintf(name, sizeof(name), "%zu keys (std::unordered_map)", n);
+            report_latency(name, lookups, best_of(5, [&] {
+                std::size_t found = 0;
+                for(std::size_t r = 0; r != rounds; ++r)
+                    for(auto const& key: keys)
+                        found += map.find(key) != map.end();
+                sink = found;
+            }));
+            std::snprintf(name, sizeof(name), "%zu keys (value::find)", n);
+            report_latency(name, lookups, best_of(5, [&] {
+                std::size_t found = 0;
+                for(std::size_t r = 0; r != rounds; ++r)
+                    for(auto const& key: keys)
+                        found += section.find(key) != nullptr;
+                sink = found;
+            }));
+        }
+    }
+
+
+    void bench_arrays() {
+        std::size_t const n = 1000000;
+        std::string text = "data = [";
+        for(std::size_t i = 0; i != n; ++i)
+            text += std::to_string(i % 1000) + ", ";
+        text += "0]\n";
+        std::size_t const bytes = text.size();
+
+        report("parse_text", bytes, best_of(5, [&] {
+            sink = confetti::parse_text(text.data()).config.size();
+        }));
+
+        confetti::result const parsed = confetti::parse_text(text.data());
+        confetti::value const& data = parsed.config["default"]["data"];
+        report_latency("traverse data[i] | 0", data.size(), best_of(5, [&] {
+            long long sum = 0;
+            for(std::size_t i = 0; i != data.size(); ++i)
+                sum += *(data[i] | 0);
+            sink = std::size_t(sum);
+        }));
+        report_latency("traverse data[i].is_single()", data.size(),
+                       best_of(5, [&] {
+            std::size_t singles = 0;
+            for(std::size_t i = 0; i != data.size(); ++i)
+                singles += data[i].is_single();
+            sink = singles;
+        }));
+
+
+        std::string ids = "ids = [";
+        for(std::size_t i = 0; i != n; ++i)
+            ids += std::to_string(1000000000000ull + i * 7919) + ", ";
+        ids += "0]\n";
+        confetti::result const parsed_ids = confetti::parse_text(ids.data());
+        confetti::value const& list = parsed_ids.config["default"]["ids"];
+        for(auto const* each: {&data, &list}) {
+            confetti::value const& items = *each;
+            bool const small = each == &data;
+            report_latency(small ? "data[i] | 0 into vector (small numbers)"
+                                 : "data[i] | 0 into vector (13 digits)",
+                           items.size(), best_of(5, [&] {
+                std::vector<long long> converted;
+                converted.reserve(items.size());
+                for(std::size_t i = 0; i != items.size(); ++i)
+                    converted.push_back(*(items[i] | 0ll));
+                sink = converted.size();
+            }));
+            report_latency(small ? "data | vector (small numbers)"
+                                 : "data | vector (13 digits)",
+                           items.size(), best_of(5, [&] {
+                sink = (items | std::vector<long long>{})->size();
+            }));
+            std::vector<long long> reused;
+            report_latency(small ? "read_into reused (small numbers)"
+                                 : "read_into reused (13 digits)",
+                           items.size(), best_of(5, [&] {
+                sink = items.read_into(reused) ? reused.size() : 0;
+            }));
+            report_latency(small ? "as_range sum (small numbers)"
+                                 : "as_range sum (13 digits)",
+                           items.size(), best_of(5, [&] {
+                long long sum = 0;
+                for(auto const each: items.as_range<long long>())
+                    sum += *each;
+                sink = std::size_t(sum);
+            }));
+        }
+
+        std::string words = "words = [";
+        for(std::size_t i = 0; i != n / 10; ++i)
+            words += "word" + std::to_string(i) + ", ";
+        words += "end]\n";
+        confetti::result const parsed_words = confetti::parse_text(words.data());
+        confetti::value const& strings = parsed_words.config["default"]["words"];
+        report_latency("strings | vector", strings.size(), best_of(5, [&] {
+            sink = (strings | std::vector<std::string>{})->size();
+        }));
+        std::vector<std::string> reused;
+        report_latency("strings read_into reused", strings.size(),
+                       best_of(5, [&] {
+            sink = strings.read_into(reused) ? reused.size() : 0;
+        }));
+    }
+
+
+    void bench_iteration() {
+        std::size_t const n = 10000;
+        std::string text;
+        for(std::size_t i = 0; i != n; ++i)
+            text += "[upstream" + std::to_string(i) + "]\nweight = "
+                  + std::to_string(i % 100) + "\n";
+        confetti::result const parsed = confetti::parse_text(text.data());
+        std::vector<std::string> names;
+        for(std::size_t i = 0; i != n; ++i)
+            names.push_back("upstream" + std::to_string(i));
+
+        report_latency("for sections by name", n, best_of(5, [&] {
+            long long sum = 0;
+            for(auto const& name: names)
+                sum += *(parsed.config[name]["weight"] | 0);
+            sink = std::size_t(sum);
+        }));
+        report_latency("for sections in order", n, best_of(5, [&] {
+            long long sum = 0;
+            for(auto const [name, section]: parsed.config)
+                sum += *(section["weight"] | 0) + long(name.size());
+            sink = std::size_t(sum);
+        }));
+    }
+
+
+    void bench_columns() {
+        std::size_t const n = 1000000;
+        std::string text = "data = [";
+        for(std::size_t i = 0; i != n; ++i)
+            text += std::to_string(i % 1000) + ", ";
+        text += "0]\n";
+        std::size_t const bytes = text.size();
+
+        report("parse_text", bytes, best_of(5, [&] {
+            sink = confetti::parse_text(text.data()).config.size();
+        }));
+        report("parse_text columns", bytes, best_of(5, [&] {
+            sink = confetti::parse_text(text.data(), confetti::mode::columns)
+                .config.size();
+        }));
+
+        confetti::result const parsed = confetti::parse_text(text.data());
+        confetti::result const columns =
+            confetti::parse_text(text.data(), confetti::mode::columns);
+        confetti::value const& data = parsed.config["default"]["data"];
+        confetti::value const& column = columns.config["default"]["data"];
+        report_latency("sum data[i] | 0ll", data.size(), best_of(5, [&] {
+            long long sum = 0;
+            for(std::size_t i = 0; i != data.size(); ++i)
+                sum += *(data[i] | 0ll);
+            sink = std::size_t(sum);
+        }));
+        report_latency("sum data | vector", data.size(), best_of(5, [&] {
+            long long sum = 0;
+            auto const converted = data | std::vector<long long>{};
+            for(long long each: *converted)
+                sum += each;
+            sink = std::size_t(sum);
+        }));
+        report_latency("sum as_span", column.size(), best_of(5, [&] {
+            std::int64_t sum = 0;
+            for(std::int64_t each: column.as_span<std::int64_t>())
+                sum += each;
+            sink = std::size_t(sum);
+        }));
+        report_latency("column | vector", column.size(), best_of(5, [&] {
+            sink = (column | std::vector<long long>{})->size();
+        }));
+    }
+
+
+    void bench_reals() {
+        std::size_t const n = 1000000;
+        std::vector<std::string> numbers;
+        std::string text = "weights = [";
+        for(std::size_t i = 0; i != n; ++i) {
+            numbers.push_back(std::to_string(double(i % 9973) / 997.)
+                              .substr(0, 8) + "e-" + std::to_string(i % 7));
+            text += numbers.back() + ", ";
+        }
+        text += "0]\n";
+        std::size_t bytes = 0;
+        for(auto const& each: numbers)
+            bytes += each.size();
+
+        report("strtod", bytes, best_of(5, [&] {
+            double sum = 0.;
+            for(auto const& each: numbers)
+                sum += std::strtod(each.data(), nullptr);
+            sink = std::size_t(sum);
+        }));
+        report("parse_real", bytes, best_of(5, [&] {
+            double sum = 0.;
+            for(auto const& each: numbers)
+                sum += *confetti::detail::parse_real(each);
+            sink = std::size_t(sum);
+        }));
+        report("parse_real<float>", bytes, best_of(5, [&] {
+            float sum = 0.f;
+            for(auto const& each: numbers)
+                sum += *confetti::detail::parse_real<float>(each);
+            sink = std::size_t(sum);
+        }));
+
+        confetti::result const parsed = confetti::parse_text(text.data());
+        confetti::value const& weights = parsed.config["default"]["weights"];
+        report("weights | std::vector<double>", bytes, best_of(5, [&] {
+            sink = (weights | std::vector<double>{})->size();
+        }));
+        report("weights | std::vector<float>", bytes, best_of(5, [&] {
+            sink = (weights | std::vector<float>{})->size();
+        }));
+    }
+
+
+    void bench_typed() {
+        char const* text =
+            "[section]\nx = 123456\ny = 3.14159\nz = true\n";
+        std::size_t const n = 1000000;
+        for(auto const m: {confetti::mode::standard, confetti::mode::typed}) {
+            confetti::result const parsed = confetti::parse_text(text, m);
+            confetti::value const& section = parsed.config["section"];
+            bool const typed = m == confetti::mode::typed;
+            report_latency(typed ? "section[\"x\"] | 0 (typed)"
+                                 : "section[\"x\"] | 0 (standard)",
+                           n, best_of(5, [&] {
+                long long sum = 0;
+                for(std::size_t i = 0; i != n; ++i)
+                    sum += *(section["x"] | 0);
+                sink = std::size_t(sum);
+            }));
+            report_latency(typed ? "section[\"y\"] | 0. (typed)"
+                                 : "section[\"y\"] | 0. (standard)",
+                           n, best_of(5, [&] {
+                double sum = 0;
+                for(std::size_t i = 0; i != n; ++i)
+                    sum += *(section["y"] | 0.);
+                sink = std::size_t(sum);
+            }));
+            report_latency(typed ? "section[\"z\"] | false (typed)"
+                                 : "section[\"z\"] | false (standard)",
+                           n, best_of(5, [&] {
+                std::size_t sum = 0;
+                for(std::size_t i = 0; i != n; ++i)
+                    sum += *(section["z"] | false);
+                sink = sum;
+            }));
+        }
+    }
+
+
+    void bench_runtime_keys() {
+        std::string text = "[section]\n";
+        std::vector<std::string> keys;
+        for(std::size_t i = 0; i != 20; ++i) {
+            keys.push_back("Parameter_" + std::to_string(i * 7919));
+            text += keys.back() + " = " + std::to_string(i) + "\n";
+        }
+        confetti::result const parsed = confetti::parse_text(text.data());
+        confetti::value const& section = parsed.config["section"];
+        std::size_t const rounds = 50000;
+        std::size_t const lookups = rounds * keys.size();
+
+        report_latency("copy, downcase and lookup", lookups, best_of(5, [&] {
+            std::size_t found = 0;
+            for(std::size_t r = 0; r != rounds; ++r)
+                for(auto const& key: keys) {
+                    std::string lowered = key;
+                    for(char& c: lowered)
+                        c = confetti::detail::ascii::lower_case(c);
+                    found += section.contains(lowered);
+                }
+            sink = found;
+        }));
+        report_latency("folded lookup", lookups, best_of(5, [&] {
+            std::size_t found = 0;
+            for(std::size_t r = 0; r != rounds; ++r)
+                for(auto const& key: keys)
+                    found += !section[key].is_none();
+            sink = found;
+        }));
+        report_latency("literal lookup", lookups, best_of(5, [&] {
+            std::size_t found = 0;
+            for(std::size_t r = 0; r != rounds * keys.size(); ++r)
+                found += !section["Parameter_7919"].is_none();
+            sink = found;
+        }));
+    }
+
+
+    void bench_keys() {
+        using namespace confetti::literals;
+        std::string text = "[section]\n";
+        for(std::size_t i = 0; i != 50; ++i)
+            text += "connection_pool_parameter_" + std::to_string(i) + " = "
+                  + std::to_string(i) + "\n";
+        confetti::result const parsed = confetti::parse_text(text.data());
+        confetti::value const& section = parsed.config["section"];
+        std::string const runtime = "connection_pool_parameter_42";
+        std::size_t const n = 1000000;
+
+        report_latency("runtime string", n, best_of(5, [&] {
+            std::size_t found = 0;
+            for(std::size_t i = 0; i != n; ++i)
+                found += !section[runtime].is_none();
+            sink = found;
+        }));
+        report_latency("string literal", n, best_of(5, [&] {
+            std::size_t found = 0;
+            for(std::size_t i = 0; i != n; ++i)
+                found += !section["connection_pool_parameter_42"].is_none();
+            sink = found;
+        }));
+        static constexpr confetti::key precomputed{
+            "connection_pool_parameter_42"};
+        report_latency("constexpr key", n, best_of(5, [&] {
+            std::size_t found = 0;
+            for(std::size_t i = 0; i != n; ++i)
+                found += !section[precomputed].is_none();
+            sink = found;
+        }));
+    }
+
+
+    struct pool_settings {
+        std::string name;
+        unsigned connections{0};
+        unsigned min_idle{0};
+        unsigned max_idle{0};
+        int timeout{0};
+        int keep_alive{0};
+        double backoff{0.};
+        double jitter{0.};
+        bool validate{false};
+        bool fair{false};
+        long long max_lifetime{0};
+        unsigned long long max_bytes{0};
+    }; // pool_settings
+
+
+    constexpr confetti::schema pool_schema{
+        confetti::field{"name", &pool_settings::name},
+        confetti::field{"connections", &pool_settings::connections},
+        confetti::field{"min_idle_connections", &pool_settings::min_idle},
+        confetti::field{"max_idle_connections", &pool_settings::max_idle},
+        confetti::field{"timeout", &pool_settings::timeout},
+        confetti::field{"keep_alive_interval", &pool_settings::keep_alive},
+        confetti::field{"backoff", &pool_settings::backoff},
+        confetti::field{"jitter", &pool_settings::jitter},
+        confetti::field{"validate", &pool_settings::validate},
+        confetti::field{"fair", &pool_settings::fair},
+        confetti::field{"max_lifetime", &pool_settings::max_lifetime},
+        confetti::field{"max_bytes", &pool_settings::max_bytes}};
+
+
+    struct service_settings {
+        pool_settings pool;
+    }; // service_settings
+
+
+    constexpr confetti::schema service_schema{
+        confetti::field{"pool", &service_settings::pool, pool_schema}};
+
+
+    void bench_binding() {
+        char const* text =
+            "[pool]\n"
+            "name = primary\n"
+            "connections = 64\n"
+            "min_idle_connections = 4\n"
+            "max_idle_connections = 16\n"
+            "timeout = 30\n"
+            "keep_alive_interval = 60\n"
+            "backoff = 1.5\n"
+            "jitter = 0.25\n"
+            "validate = true\n"
+            "fair = false\n"
+            "max_lifetime = 3600\n"
+            "max_bytes = 1048576\n";
+        confetti::result const parsed = confetti::parse_text(text);
+        confetti::value const& section = parsed.config["pool"];
+        std::size_t const n = 200000;
+
+        report_latency("operator | chain", n, best_of(5, [&] {
+            std::size_t total = 0;
+            for(std::size_t i = 0; i != n; ++i) {
+                pool_settings p;
+                p.name = *(section["name"] | std::string{});
+                p.connections = *(section["connections"] | 0u);
+                p.min_idle = *(section["min_idle_connections"] | 0u);
+                p.max_idle = *(section["max_idle_connections"] | 0u);
+                p.timeout = *(section["timeout"] | 0);
+                p.keep_alive = *(section["keep_alive_interval"] | 0);
+                p.backoff = *(section["backoff"] | 0.);
+                p.jitter = *(section["jitter"] | 0.);
+                p.validate = *(section["validate"] | false);
+                p.fair = *(section["fair"] | false);
+                p.max_lifetime = *(section["max_lifetime"] | 0ll);
+                p.max_bytes = *(section["max_bytes"] | 0ull);
+                total += p.connections + p.name.size();
+            }
+            sink = total;
+        }));
+        report_latency("bind", n, best_of(5, [&] {
+            std::size_t total = 0;
+            for(std::size_t i = 0; i != n; ++i) {
+                pool_settings p;
+                total += confetti::bind(section, p, pool_schema).size();
+                total += p.connections + p.name.size();
+            }
+            sink = total;
+        }));
+        report_latency("parse_text and bind", n, best_of(5, [&] {
+            std::size_t total = 0;
+            for(std::size_t i = 0; i != n; ++i) {
+                service_settings service;
+                confetti::result const r = confetti::parse_text(text);
+                total += confetti::bind(r.config, service, service_schema)
+                             .size();
+                total += service.pool.connections;
+            }
+            sink = total;
+        }));
+        report_latency("parse_text_into", n, best_of(5, [&] {
+            std::size_t total = 0;
+            for(std::size_t i = 0; i != n; ++i) {
+                service_settings service;
+                total += !confetti::parse_text_into(text, service,
+                                                    service_schema);
+                total += service.pool.connections;
+            }
+            sink = total;
+        }));
+    }
+
+
+    struct counter: confetti::handler {
+        std::size_t scalars{0};
+        bool on_scalar(std::string_view) { ++scalars; return true; }
+    }; // counter
+
+
+    // Extracts single setting from huge config, like a tool would do
+    struct extractor: confetti::handler {
+        std::string_view section;
+        std::string_view key;
+        std::string_view found;
+        bool inside{false};
+        bool matched{false};
+
+        bool on_section(std::string_view name) {
+            inside = name == section;
+            return true;
+        }
+        bool on_key(std::string_view name) {
+            matched = inside && name == key;
+            return true;
+        }
+        bool on_scalar(std::string_view text) {
+            if(!matched)
+                return true;
+            found = text;
+            return false;
+        }
+    }; // extractor
+
+
+    void bench_sax() {
+        std::string const text = make_config(100000);
+        std::size_t const bytes = text.size() - confetti::detail::source_padding;
+
+        report("parse_text", bytes, best_of(5, [&] {
+            sink = confetti::parse_text(text.data()).config.size();
+        }));
+        report("scan_text", bytes, best_of(5, [&] {
+            counter c;
+            confetti::scan_text(text.data(), c);
+            sink = c.scalars;
+        }));
+        // Throughput relative to whole text
+        report("scan_text (stop at middle)", bytes, best_of(5, [&] {
+            extractor e;
+            e.section = "section50000";
+            e.key = "threads";
+            confetti::scan_text(text.data(), e);
+            sink = e.found.size();
+        }));
+    }
+
+
+    void bench_push() {
+        std::string const text = make_config(100000);
+        std::size_t const bytes = text.size() - confetti::detail::source_padding;
+        std::string_view const source{text.data(), bytes};
+
+        report("parse_text", bytes, best_of(5, [&] {
+            sink = confetti::parse_text(text.data()).config.size();
+        }));
+        for(std::size_t const chunk: {512, 4096, 65536}) {
+            char name[64];
+            std::snprintf(name, sizeof(name), "push_parser (%zu byte chunks)",
+                          chunk);
+            report(name, bytes, best_of(5, [&] {
+                confetti::push_parser parser;
+                for(std::size_t i = 0; i < bytes; i += chunk)
+                    parser.feed(source.substr(i, chunk));
+                sink = parser.finish().config.size();
+            }));
+        }
+    }
+
+
+    void bench_lazy() {
+        std::size_t const sections = 10000;
+        std::string const text = make_config(sections);
+        std::size_t const bytes = text.size() - confetti::detail::source_padding;
+        std::vector<std::string> names;
+        for(std::size_t i = 0; i != sections; ++i)
+            names.push_back("section" + std::to_string(i));
+
+        report("parse_text (standard)", bytes, best_of(5, [&] {
+            sink = confetti::parse_text(text.data()).config.size();
+        }));
+        for(std::size_t const percents: {1, 10, 100}) {
+            char name[64];
+            std::snprintf(name, sizeof(name),
+                          "parse_text (lazy, %zu%% sections used)", percents);
+            std::size_t const step = 100 / percents;
+            report(name, bytes, best_of(5, [&] {
+                confetti::result const r =
+                    confetti::parse_text(text.data(), confetti::mode::lazy);
+                std::size_t found = 0;
+                for(std::size_t i = 0; i < sections; i += step)
+                    found += r.config[names[i]].size();
+                sink = found;
+            }));
+        }
+    }
+
+
+    void bench_parallel() {
+        std::string const text = make_config(200000);
+        std::size_t const bytes = text.size() - confetti::detail::source_padding;
+
+        report("parse_text (standard)", bytes, best_of(5, [&] {
+            sink = confetti::parse_text(text.data()).config.size();
+        }));
+        char name[64];
+        std::snprintf(name, sizeof(name), "parse_text (parallel, %u threads)",
+                      std::thread::hardware_concurrency());
+        report(name, bytes, best_of(5, [&] {
+            sink = confetti::parse_text(text.data(), confetti::mode::parallel)
+                       .config.size();
+        }));
+    }
+
+
+    void bench_many() {
+        std::vector<std::string> names;
+        for(std::size_t i = 0; i != 256; ++i) {
+            names.push_back("confetti-bench-tenant-" + std::to_string(i)
+                            + ".ini");
+            std::string const text = make_config(20);
+            std::FILE* file = std::fopen(names.back().data(), "wb");
+            if(file == nullptr)
+                return;
+            std::fwrite(text.data(), 1,
+                        text.size() - confetti::detail::source_padding, file);
+            std::fclose(file);
+        }
+
+        std::size_t const n = names.size();
+        report_latency("parse in serial loop (per file)", n, best_of(5, [&] {
+            std::size_t parsed = 0;
+            for(auto const& name: names)
+                parsed += confetti::parse(name).config.size();
+            sink = parsed;
+        }));
+        for(unsigned const workers: {1u, 2u, 4u, 0u}) {
+            char name[64];
+            std::snprintf(name, sizeof(name),
+                          "parse_many, %u workers (per file)",
+                          workers == 0 ? std::thread::hardware_concurrency()
+                                       : workers);
+            report_latency(name, n, best_of(5, [&] {
+                sink = confetti::parse_many(names, confetti::mode::standard,
+                                            workers).size();
+            }));
+        }
+        report_latency("parse_each (per file)", n, best_of(5, [&] {
+            std::size_t parsed = 0;
+            confetti::parse_each(names, [&](std::size_t, confetti::result&& r) {
+                parsed += r.config.size();
+            });
+            sink = parsed;
+        }));
+        report_latency("parse_each on threads (per file)", n, best_of(5, [&] {
+            std::size_t parsed = 0;
+            auto done = [&](std::size_t, confetti::result&& r) {
+                parsed += r.config.size();
+            };
+            confetti::detail::parse_each_on_threads(names, done,
+                                                    confetti::mode::standard);
+            sink = parsed;
+        }));
+        for(auto const& name: names)
+            std::remove(name.data());
+    }
+
+
+    void bench_diff() {
+        std::string const text = make_config(100000);
+        std::size_t const bytes = text.size() - confetti::detail::source_padding;
+        std::string changed = text;
+        changed[changed.find("threads = 7\n") + 10] = '8';
+        confetti::result const before = confetti::parse_text(text.data());
+        confetti::result const after = confetti::parse_text(changed.data());
+
+        report("fingerprint", bytes, best_of(5, [&] {
+            sink = std::size_t(confetti::fingerprint(after));
+        }));
+        report("diff (one change)", bytes, best_of(5, [&] {
+            sink = confetti::diff(before, after).size();
+        }));
+    }
+
+
+    void bench_image() {
+        std::string const text = make_config(100000);
+        std::size_t const bytes = text.size() - confetti::detail::source_padding;
+        char const* source = "confetti-bench-source.ini";
+        char const* cache = "confetti-bench-source.image";
+        std::FILE* file = std::fopen(source, "wb");
+        if(file == nullptr)
+            return;
+        std::fwrite(text.data(), 1, bytes, file);
+        std::fclose(file);
+        confetti::result const parsed = confetti::parse(source);
+        confetti::save_image(parsed, cache);
+        std::string const key = "section77777";
+
+        report_latency("parse and lookup", 1, best_of(5, [&] {
+            confetti::result const r = confetti::parse(source);
+            sink = *(r.config[key]["threads"] | 0);
+        }));
+        report_latency("load_image and lookup", 1, best_of(5, [&] {
+            confetti::image const loaded = confetti::load_image(cache);
+            sink = *(loaded.config[key]["threads"] | 0);
+        }));
+        report_latency("load_cached and lookup", 1, best_of(5, [&] {
+            confetti::image const loaded = confetti::load_cached(source, cache);
+            sink = *(loaded.config[key]["threads"] | 0);
+        }));
+        std::remove(source);
+        std::remove(cache);
+    }
+
+
+    struct benchmark {
+        char const* name;
+        void (*run)();
+    }; // benchmark
+
+
+    benchmark const benchmarks[] = {
+        {"scaner", bench_scaner},
+        {"engines", bench_engines},
+        {"tables", bench_tables},
+        {"arrays", bench_arrays},
+        {"iteration", bench_iteration},
+        {"columns", bench_columns},
+        {"reals", bench_reals},
+        {"typed", bench_typed},
+        {"runtime_keys", bench_runtime_keys},
+        {"keys", bench_keys},
+        {"sax", bench_sax},
+        {"push", bench_push},
+        {"lazy", bench_lazy},
+        {"parallel", bench_parallel},
+        {"many", bench_many},
+        {"diff", bench_diff},
+        {"binding", bench_binding},
+        {"image", bench_image},
+    };
+
+} // namespace
+
+
+int main(int argc, char** argv) {
+    for(auto const& each: benchmarks) {
+        if(argc > 1 && std::strcmp(argv[1], each.name) != 0)
+            continue;
+        std::printf("## %s\n", each.name);
+        each.run();
+    }
+    return 0;
+}
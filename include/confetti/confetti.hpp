@@ -5,19 +5,55 @@
 #pragma once
 
 
+#include <algorithm>
+#include <atomic>
 #include <charconv>
+#include <cstdint>
 #include <cstdio>
+#include <cstdlib>
 #include <cstring>
+#include <iterator>
+#include <limits>
 #include <memory>
+#include <mutex>
+#include <new>
 #include <optional>
 #include <string>
 #include <string_view>
 #include <system_error>
+#include <thread>
+#include <tuple>
+#include <type_traits>
 #include <unordered_map>
-#include <variant>
+#include <utility>
 #include <vector>
 
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define CONFETTI_HAS_MMAP 1
+#else
+#define CONFETTI_HAS_MMAP 0
+#endif
+
+#if !defined(CONFETTI_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) \
+    || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define CONFETTI_SSE2 1
+#if defined(__SSSE3__) || defined(__AVX__)
+#include <tmmintrin.h>
+#define CONFETTI_SSSE3 1
+#endif
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define CONFETTI_AVX2 1
+#endif
+#endif
+
 #ifdef _MSC_VER
+#include <intrin.h>
 #pragma warning(disable : 4996) // "unsafe" CRT functions
 #endif
 
@@ -39,7 +75,11 @@ enum struct error {
     expected_comma_or_closed_square_brace,
     expected_parameter_in_table,
     expected_comma_or_closed_figure_brace,
-    unclosed_string
+    unclosed_string,
+    unexpected_section,
+    unexpected_parameter,
+    unable_to_write_file,
+    invalid_image
 }; // error
 
 
@@ -79,6 +119,14 @@ struct error_category : std::error_category {
             return "Expected ',' or '}'";
         case error::unclosed_string:
             return "Unclosed string";
+        case error::unexpected_section:
+            return "Unexpected section";
+        case error::unexpected_parameter:
+            return "Unexpected parameter";
+        case error::unable_to_write_file:
+            return "Unable to write file";
+        case error::invalid_image:
+            return "Invalid or incompatible binary image";
         default:
             return "Unknown";
         }
@@ -129,467 +177,2528 @@ namespace detail::ascii {
 } // namespace detail::ascii
 
 
-class value {
-    using array = std::vector<value>;
-    using array_ptr = std::unique_ptr<array>;
-    using table = std::unordered_map<std::string_view, value>;
-    using table_ptr = std::unique_ptr<table>;
-public:
-    using size_type = size_t;
+enum struct mode : unsigned {
+    standard = 0,
+    mapped = 1,
+    indexed = 2,
+    typed = 4,
+    lazy = 8,
+    parallel = 16,
+    columns = 32
+}; // mode
 
-    static value const none;
 
-    static value make(std::string_view const& sv) noexcept { return value{sv}; }
-    static value make_array() noexcept { return value{std::make_unique<array>()}; }
-    static value make_table() noexcept { return value{std::make_unique<table>()}; }
+constexpr mode operator | (mode lhs, mode rhs) noexcept {
+    return mode(unsigned(lhs) | unsigned(rhs));
+}
 
-    value() noexcept = default;
-    value(value const &) = delete;
-    value &operator=(value const &) = delete;
-    value(value &&) noexcept = default;
-    value &operator=(value &&) noexcept = default;
 
-    bool is_none() const noexcept {
-        return std::holds_alternative<std::monostate>(holder_);
+namespace detail {
+
+    constexpr bool enabled(mode set, mode flag) noexcept {
+        return (unsigned(set) & unsigned(flag)) != 0;
     }
 
-    bool is_single() const noexcept {
-        return std::holds_alternative<std::string_view>(holder_);
+    // Bytes of zeros after the end of text, scaner stops at the first '\0'
+    // but vectorized search may load whole 64 bytes block past it
+    inline constexpr std::size_t source_padding = 64;
+
+    struct source_deleter {
+        std::size_t mapped_size{0};
+
+        void operator()(char* source) const noexcept {
+            if(mapped_size == 0) {
+                delete[] source;
+                return;
+            }
+#if CONFETTI_HAS_MMAP
+            ::munmap(source, mapped_size);
+#endif
+        }
+    }; // source_deleter
+
+    using source_ptr = std::unique_ptr<char[], source_deleter>;
+
+} // namespace detail
+
+
+namespace detail {
+
+    inline unsigned trailing_zeros(std::uint64_t bits) noexcept {
+#if defined(_MSC_VER) && defined(_M_X64)
+        unsigned long index;
+        _BitScanForward64(&index, bits);
+        return unsigned(index);
+#elif defined(_MSC_VER)
+        unsigned long index;
+        if(_BitScanForward(&index, unsigned(bits)))
+            return unsigned(index);
+        _BitScanForward(&index, unsigned(bits >> 32));
+        return unsigned(index) + 32;
+#else
+        return unsigned(__builtin_ctzll(bits));
+#endif
     }
 
-    bool is_array() const noexcept {
-        return std::holds_alternative<array_ptr>(holder_);
+} // namespace detail
+
+
+namespace detail::scalar {
+
+    inline char const* find_line_end(char const* cursor) noexcept {
+        for(;; ++cursor)
+            switch(*cursor) {
+            case '\n': case '\0':
+                return cursor;
+            default:
+                continue;
+            }
     }
 
-    bool is_table() const noexcept {
-        return std::holds_alternative<table_ptr>(holder_);
+    template<char Q>
+    char const* find_string_end(char const* cursor) noexcept {
+        for(;; ++cursor)
+            switch(*cursor) {
+            case '\n': case '\0': case Q:
+                return cursor;
+            default:
+                continue;
+            }
     }
 
-    size_type size() const noexcept {
-        array_ptr const *ap = std::get_if<array_ptr>(&holder_);
-        if (ap != nullptr)
-            return ap->get()->size();
-        table_ptr const *tp = std::get_if<table_ptr>(&holder_);
-        if (tp != nullptr)
-            return tp->get()->size();
-        return 0;
+    inline char const* find_word_end(char const* cursor) noexcept {
+        // clang-format off
+        for(;; ++cursor)
+            switch(*cursor) {
+            case ' ': case '\t': case '\r': case '\n': case '\0':
+            case '[': case ']': case '{': case '}': case '=':
+            case ',': case '"': case '\'': case '#': case ';':
+                return cursor;
+            default:
+                continue;
+            }
+        // clang-format on
     }
 
-    bool empty() const noexcept {
-        return size() == 0;
+} // namespace detail::scalar
+
+
+#if CONFETTI_SSE2
+
+namespace detail::simd {
+
+    inline unsigned first_bit(unsigned mask) noexcept {
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanForward(&index, mask);
+        return unsigned(index);
+#else
+        return unsigned(__builtin_ctz(mask));
+#endif
     }
 
-    bool emplace_back(value &&v) noexcept {
-        try {
-            array_ptr const *p = std::get_if<array_ptr>(&holder_);
-            if (p == nullptr)
-                return false;
-            array &data = *p->get();
-            data.emplace_back(std::move(v));
-            return true;
-        } catch (std::bad_alloc const &) {
-            return false;
-        }
+    inline __m128i load(char const* cursor) noexcept {
+        return _mm_loadu_si128(reinterpret_cast<__m128i const*>(cursor));
     }
 
-    value const& operator [] (size_type i) const noexcept {
-        array_ptr const* p = std::get_if<array_ptr>(&holder_);
-        if (p == nullptr)
-            return none;
-        array const &data = *p->get();
-        return data[i];
+    inline __m128i equal(__m128i chunk, char c) noexcept {
+        return _mm_cmpeq_epi8(chunk, _mm_set1_epi8(c));
     }
 
-    template<std::size_t N>
-    value const& operator [] (char const (&name)[N]) const noexcept {
-        table_ptr const *p = std::get_if<table_ptr>(&holder_);
-        if (p == nullptr)
-            return none;
-        table const& table = *p->get();
-        auto const found = table.find(std::string_view{name, N - 1});
-        if (found == table.end())
-            return none;
-        return found->second;
+#if CONFETTI_SSSE3
+
+    // Nibble lookup: each byte of word delimiters class has the same bit set
+    // in both tables, other bytes have no common bits
+    inline __m128i word_delimiters(__m128i chunk) noexcept {
+        __m128i const low_table = _mm_setr_epi8(
+            3, 0, 2, 2, 0, 0, 0, 2, 0, 1, 1, 4, 2, 5, 0, 0);
+        __m128i const high_table = _mm_setr_epi8(
+            1, 0, 2, 4, 0, 4, 0, 4, 0, 0, 0, 0, 0, 0, 0, 0);
+        __m128i const nibble = _mm_set1_epi8(0x0F);
+        __m128i const low = _mm_shuffle_epi8(low_table,
+                                             _mm_and_si128(chunk, nibble));
+        __m128i const high = _mm_shuffle_epi8(
+            high_table, _mm_and_si128(_mm_srli_epi16(chunk, 4), nibble));
+        return _mm_xor_si128(
+            _mm_cmpeq_epi8(_mm_and_si128(low, high), _mm_setzero_si128()),
+            _mm_set1_epi8(-1));
     }
 
-    value *insert(std::string_view const &name, value &&value) {
-        table_ptr const *p = std::get_if<table_ptr>(&holder_);
-        if (p == nullptr)
-            return nullptr;
-        table &data = *p->get();
-        auto const found = data.find(name);
-        if (found != data.end())
-            return nullptr;
-        auto emplaced = data.try_emplace(name, std::move(value));
-        if (!emplaced.second)
-            return nullptr;
-        return &emplaced.first->second;
+#else
+
+    inline __m128i word_delimiters(__m128i chunk) noexcept {
+        __m128i spaces = _mm_or_si128(
+            _mm_or_si128(equal(chunk, ' '), equal(chunk, '\t')),
+            _mm_or_si128(equal(chunk, '\r'), equal(chunk, '\n')));
+        __m128i braces = _mm_or_si128(
+            _mm_or_si128(equal(chunk, '['), equal(chunk, ']')),
+            _mm_or_si128(equal(chunk, '{'), equal(chunk, '}')));
+        __m128i punctuation = _mm_or_si128(
+            _mm_or_si128(equal(chunk, '='), equal(chunk, ',')),
+            _mm_or_si128(equal(chunk, '"'), equal(chunk, '\'')));
+        __m128i rest = _mm_or_si128(
+            _mm_or_si128(equal(chunk, '#'), equal(chunk, ';')),
+            equal(chunk, '\0'));
+        return _mm_or_si128(_mm_or_si128(spaces, braces),
+                            _mm_or_si128(punctuation, rest));
     }
 
-    value* find(std::string_view const& name) noexcept {
-        table_ptr* p = std::get_if<table_ptr>(&holder_);
-        if (p == nullptr)
-            return nullptr;
-        table& table = *p->get();
-        auto const found = table.find(name);
-        if (found == table.end())
-            return nullptr;
-        return &found->second;
+#endif
 
-    }
+#if CONFETTI_AVX2
 
-    template <std::size_t N> value* find(char const (&name)[N]) noexcept {
-            return find(std::string_view{name, N - 1});
+    inline __m256i load256(char const* cursor) noexcept {
+        return _mm256_loadu_si256(reinterpret_cast<__m256i const*>(cursor));
     }
 
-    bool contains(std::string_view const &name) const noexcept {
-        table_ptr const *p = std::get_if<table_ptr>(&holder_);
-        if (p == nullptr)
-            return false;
-        table const& table = *p->get();
-        auto const found = table.find(name);
-        if (found == table.end())
-            return false;
-        return true;
+    inline __m256i equal(__m256i chunk, char c) noexcept {
+        return _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(c));
     }
 
-    template <std::size_t N>
-    bool contains(char const (&name)[N]) const noexcept {
-        return contains(std::string_view{name, N - 1});
+    inline __m256i word_delimiters(__m256i chunk) noexcept {
+        __m256i const low_table = _mm256_setr_epi8(
+            3, 0, 2, 2, 0, 0, 0, 2, 0, 1, 1, 4, 2, 5, 0, 0,
+            3, 0, 2, 2, 0, 0, 0, 2, 0, 1, 1, 4, 2, 5, 0, 0);
+        __m256i const high_table = _mm256_setr_epi8(
+            1, 0, 2, 4, 0, 4, 0, 4, 0, 0, 0, 0, 0, 0, 0, 0,
+            1, 0, 2, 4, 0, 4, 0, 4, 0, 0, 0, 0, 0, 0, 0, 0);
+        __m256i const nibble = _mm256_set1_epi8(0x0F);
+        __m256i const low = _mm256_shuffle_epi8(
+            low_table, _mm256_and_si256(chunk, nibble));
+        __m256i const high = _mm256_shuffle_epi8(
+            high_table, _mm256_and_si256(_mm256_srli_epi16(chunk, 4), nibble));
+        return _mm256_xor_si256(
+            _mm256_cmpeq_epi8(_mm256_and_si256(low, high),
+                              _mm256_setzero_si256()),
+            _mm256_set1_epi8(-1));
     }
 
-    std::optional<bool> operator | (bool bydefault) const noexcept {
-        using detail::ascii::lower_case;
-
-        if(std::holds_alternative<std::monostate>(holder_))
-            return {bydefault};
+    inline char const* find_line_end(char const* cursor) noexcept {
+        for(;; cursor += 32) {
+            __m256i const chunk = load256(cursor);
+            unsigned const mask = unsigned(_mm256_movemask_epi8(
+                _mm256_or_si256(equal(chunk, '\n'), equal(chunk, '\0'))));
+            if(mask != 0)
+                return cursor + first_bit(mask);
+        }
+    }
 
-        std::string_view const *p = std::get_if<std::string_view>(&holder_);
-        if (p == nullptr)
-            return std::nullopt;
-        bool parsed;
-        char const *cc = p->data();
-
-        switch(p->size()) {
-        case 4:
-            parsed = lower_case(cc[0]) == 't' && lower_case(cc[1] == 'r') &&
-                    lower_case(cc[2]) == 'u' && lower_case(cc[3] == 'e');
-            if(!parsed)
-                return std::nullopt;
-            return {true};
-        case 5:
-            parsed = lower_case(cc[0]) == 'f' && lower_case(cc[1]) == 'a' &&
-                    lower_case(cc[2]) == 'l' && lower_case(cc[3]) == 's' &&
-                    lower_case(cc[4]) == 'e';
-            if(!parsed)
-                return std::nullopt;
-        return { false };
-        default:
-            return std::nullopt;
+    template<char Q>
+    char const* find_string_end(char const* cursor) noexcept {
+        for(;; cursor += 32) {
+            __m256i const chunk = load256(cursor);
+            unsigned const mask = unsigned(_mm256_movemask_epi8(
+                _mm256_or_si256(
+                    _mm256_or_si256(equal(chunk, '\n'), equal(chunk, '\0')),
+                    equal(chunk, Q))));
+            if(mask != 0)
+                return cursor + first_bit(mask);
         }
     }
 
-    std::optional<int> operator | (int bydefault) const noexcept {
-        if(std::holds_alternative<std::monostate>(holder_))
-            return {bydefault};
-        return parse_signed<int>();
+    inline char const* find_word_end(char const* cursor) noexcept {
+        for(;; cursor += 32) {
+            unsigned const mask = unsigned(
+                _mm256_movemask_epi8(word_delimiters(load256(cursor))));
+            if(mask != 0)
+                return cursor + first_bit(mask);
+        }
     }
 
-    std::optional<unsigned> operator | (unsigned bydefault) const noexcept {
-        if(std::holds_alternative<std::monostate>(holder_))
-            return {bydefault};
-        return parse_unsigned<unsigned>();
+#else
+
+    inline char const* find_line_end(char const* cursor) noexcept {
+        for(;; cursor += 16) {
+            __m128i const chunk = load(cursor);
+            unsigned const mask = unsigned(_mm_movemask_epi8(
+                _mm_or_si128(equal(chunk, '\n'), equal(chunk, '\0'))));
+            if(mask != 0)
+                return cursor + first_bit(mask);
+        }
     }
 
-    std::optional<long long> operator | (long long bydefault) const noexcept {
-        if(std::holds_alternative<std::monostate>(holder_))
-            return {bydefault};
-        return parse_signed<long long>();
+    template<char Q>
+    char const* find_string_end(char const* cursor) noexcept {
+        for(;; cursor += 16) {
+            __m128i const chunk = load(cursor);
+            unsigned const mask = unsigned(_mm_movemask_epi8(
+                _mm_or_si128(
+                    _mm_or_si128(equal(chunk, '\n'), equal(chunk, '\0')),
+                    equal(chunk, Q))));
+            if(mask != 0)
+                return cursor + first_bit(mask);
+        }
     }
 
-    std::optional<unsigned long long>
-    operator | (unsigned long long bydefault) const noexcept {
-        if(std::holds_alternative<std::monostate>(holder_))
-            return {bydefault};
-        return parse_unsigned<unsigned long long>();
+    inline char const* find_word_end(char const* cursor) noexcept {
+        for(;; cursor += 16) {
+            unsigned const mask = unsigned(
+                _mm_movemask_epi8(word_delimiters(load(cursor))));
+            if(mask != 0)
+                return cursor + first_bit(mask);
+        }
     }
 
-    std::optional<double> operator | (double bydefault) const {
-        if(std::holds_alternative<std::monostate>(holder_))
-            return {bydefault};
+#endif
 
-        std::string_view const *p = std::get_if<std::string_view>(&holder_);
-        if (p == nullptr)
-            return std::nullopt;
+} // namespace detail::simd
 
-        char const *head = p->data();
-        char const *tail = p->data() + p->size();
+namespace detail {
+    using simd::find_line_end;
+    using simd::find_string_end;
+    using simd::find_word_end;
+} // namespace detail
 
-        if (*head == '+')
-            ++head;
+#else
 
-    #ifdef _MSC_VER
-        double number;
-        auto const parsed = std::from_chars(head, tail, number);
+namespace detail {
+    using scalar::find_line_end;
+    using scalar::find_string_end;
+    using scalar::find_word_end;
+} // namespace detail
 
-        if (parsed.ec == std::errc::invalid_argument)
-            return std::nullopt;
-    #else
-        char *endptr;
-        double number = std::strtod(head, &endptr);
-        if (endptr != tail)
-            return std::nullopt;
-    #endif
+#endif
 
-        return {number};
-    }
 
-    std::optional<std::string_view>
-    operator | (std::string_view const& bydefault) const noexcept {
-        if(std::holds_alternative<std::monostate>(holder_))
-            return {bydefault};
-        std::string_view const *p = std::get_if<std::string_view>(&holder_);
-        if (p == nullptr)
-            return std::nullopt;
+namespace detail {
 
-        return {*p};
+// Monotonic allocator: memory is released all at once when arena dies
+class arena {
+public:
+    arena() noexcept = default;
+    arena(arena const&) = delete;
+    arena& operator = (arena const&) = delete;
+
+    arena(arena&& other) noexcept:
+        last_{other.last_}, cursor_{other.cursor_}, end_{other.end_},
+        adopted_{std::move(other.adopted_)},
+        blocks_{other.blocks_.exchange(nullptr)} {
+        other.last_ = nullptr;
+        other.cursor_ = other.end_ = nullptr;
     }
 
-    std::optional<std::string> operator | (char const* bydefault) const {
-        if(std::holds_alternative<std::monostate>(holder_))
-            return {std::string{bydefault}};
-        std::string_view const *p = std::get_if<std::string_view>(&holder_);
-        if (p == nullptr)
-            return std::nullopt;
-
-        return {std::string{p->begin(), p->end()}};
+    arena& operator = (arena&& other) noexcept {
+        if(this == &other)
+            return *this;
+        release();
+        last_ = other.last_;
+        cursor_ = other.cursor_;
+        end_ = other.end_;
+        adopted_ = std::move(other.adopted_);
+        blocks_.store(other.blocks_.exchange(nullptr));
+        other.last_ = nullptr;
+        other.cursor_ = other.end_ = nullptr;
+        return *this;
     }
 
-    std::optional<std::string>
-    operator | (std::string const& bydefault) const {
-        if(std::holds_alternative<std::monostate>(holder_))
-            return {bydefault};
-        std::string_view const *p = std::get_if<std::string_view>(&holder_);
-        if (p == nullptr)
-            return std::nullopt;
+    ~arena() { release(); }
 
-        return {std::string{p->begin(), p->end()}};
+    void* allocate(std::size_t size, std::size_t alignment) noexcept {
+        std::size_t const misalignment =
+            std::uintptr_t(cursor_) & (alignment - 1);
+        std::size_t const skip = misalignment == 0 ? 0 : alignment - misalignment;
+        if(cursor_ != nullptr && skip + size <= std::size_t(end_ - cursor_)) {
+            void* allocated = cursor_ + skip;
+            cursor_ += skip + size;
+            return allocated;
+        }
+        return allocate_chunk(size, alignment);
     }
 
-    std::optional<std::vector<bool>>
-    operator | (std::vector<bool> bydefault) const {
-        if(std::holds_alternative<std::monostate>(holder_))
-            return {std::move(bydefault)};
-        return parse_array<bool>();
+    template<typename T, typename... Args> T* create(Args&&... args) noexcept {
+        void* allocated = allocate(sizeof(T), alignof(T));
+        if(allocated == nullptr)
+            return nullptr;
+        return new(allocated) T(std::forward<Args>(args)...);
     }
 
-    std::optional<std::vector<int>>
-    operator | (std::vector<int> bydefault) const {
-        if(std::holds_alternative<std::monostate>(holder_))
-            return {std::move(bydefault)};
-        return parse_array<int>();
+    // Blocks made while parsed result is read, possibly by several threads.
+    // Kept block is freed with arena
+    static void* allocate_block(std::size_t size) noexcept {
+        void* memory = std::malloc(sizeof(block) + size);
+        if(memory == nullptr)
+            return nullptr;
+        return static_cast<block*>(memory) + 1;
     }
 
-    std::optional<std::vector<unsigned>>
-    operator | (std::vector<unsigned> const& bydefault) const {
-        if(std::holds_alternative<std::monostate>(holder_))
-            return {std::move(bydefault)};
-        return parse_array<unsigned>();
+    static void free_block(void* allocated) noexcept {
+        std::free(static_cast<block*>(allocated) - 1);
     }
 
-    std::optional<std::vector<long long>>
-    operator | (std::vector<long long> bydefault) const {
-        if(std::holds_alternative<std::monostate>(holder_))
-            return {std::move(bydefault)};
-        return parse_array<long long>();
+    void keep_block(void* allocated) noexcept {
+        block* const kept = static_cast<block*>(allocated) - 1;
+        kept->next = blocks_.load(std::memory_order_relaxed);
+        while(!blocks_.compare_exchange_weak(kept->next, kept,
+                                             std::memory_order_release,
+                                             std::memory_order_relaxed)) { }
     }
 
-    std::optional<std::vector<unsigned long long>>
-    operator | (std::vector<unsigned long long> bydefault) const {
-        if(std::holds_alternative<std::monostate>(holder_))
-            return {std::move(bydefault)};
-        return parse_array<unsigned long long>();
+    // Keeps other arena alive as long as this one: tables allocated from
+    // it hold its address and may still grow
+    void adopt(std::unique_ptr<arena> other) noexcept {
+        if(!other)
+            return;
+        arena* last = other.get();
+        while(last->adopted_)
+            last = last->adopted_.get();
+        last->adopted_ = std::move(adopted_);
+        adopted_ = std::move(other);
     }
 
-    std::optional<std::vector<double>>
-    operator | (std::vector<double> bydefault) const {
-        if(std::holds_alternative<std::monostate>(holder_))
-            return {std::move(bydefault)};
-        return parse_array<double>();
-    }
+private:
+    struct chunk {
+        chunk* previous;
+        std::size_t size;
+    }; // chunk
 
-    std::optional<std::vector<std::string_view>>
-    operator | (std::vector<std::string_view> bydefault) const {
-        if(std::holds_alternative<std::monostate>(holder_))
-            return {std::move(bydefault)};
-        return parse_array<std::string_view>();
+    struct alignas(16) block {
+        block* next;
+    }; // block
+
+    static constexpr std::size_t first_chunk_size = 4096;
+    static constexpr std::size_t max_chunk_size = 1024 * 1024;
+
+    chunk* last_{nullptr};
+    char* cursor_{nullptr};
+    char* end_{nullptr};
+    std::unique_ptr<arena> adopted_;
+    std::atomic<block*> blocks_{nullptr};
+
+    void* allocate_chunk(std::size_t size, std::size_t alignment) noexcept {
+        std::size_t chunk_size = last_ == nullptr
+            ? first_chunk_size
+            : (last_->size < max_chunk_size ? last_->size * 2 : max_chunk_size);
+        std::size_t const required = sizeof(chunk) + alignment + size;
+        if(required < size)
+            return nullptr;
+        if(chunk_size < required)
+            chunk_size = required;
+        void* memory = std::malloc(chunk_size);
+        if(memory == nullptr)
+            return nullptr;
+        chunk* const allocated = static_cast<chunk*>(memory);
+        allocated->previous = last_;
+        allocated->size = chunk_size;
+        last_ = allocated;
+        cursor_ = reinterpret_cast<char*>(allocated + 1);
+        end_ = static_cast<char*>(memory) + chunk_size;
+        return allocate(size, alignment);
     }
 
-    std::optional<std::vector<std::string>>
-    operator | (std::vector<std::string> bydefault) const {
-        if(std::holds_alternative<std::monostate>(holder_))
-            return {std::move(bydefault)};
-        return parse_array<std::string>();
+    void release() noexcept {
+        while(last_ != nullptr) {
+            chunk* const previous = last_->previous;
+            std::free(last_);
+            last_ = previous;
+        }
+        cursor_ = end_ = nullptr;
+        for(block* each = blocks_.exchange(nullptr); each != nullptr;) {
+            block* const next = each->next;
+            std::free(each);
+            each = next;
+        }
     }
+}; // arena
 
-private:
 
-	using holder_type = std::variant<std::monostate, std::string_view,
-	                                 array_ptr, table_ptr>;
+template<typename T> class arena_allocator {
+public:
+    using value_type = T;
+
+    explicit arena_allocator(arena& a) noexcept: arena_{&a} { }
 
-	holder_type holder_;
+    template<typename U>
+    arena_allocator(arena_allocator<U> const& other) noexcept:
+        arena_{other.get_arena()}
+    { }
 
-	value(std::string_view const& sv) noexcept: holder_{sv} { }
-	value(array_ptr p) noexcept: holder_{std::move(p)} { }
-	value(table_ptr p) noexcept: holder_{std::move(p)} { }
+    arena* get_arena() const noexcept { return arena_; }
 
-	template<typename T> std::optional<T> parse_unsigned() const noexcept {
-			std::string_view const *p = std::get_if<std::string_view>(&holder_);
-			if (p == nullptr)
-					return std::nullopt;
+    T* allocate(std::size_t n) {
+        if(n > std::size_t(-1) / sizeof(T))
+            throw std::bad_alloc{};
+        void* allocated = arena_->allocate(n * sizeof(T), alignof(T));
+        if(allocated == nullptr)
+            throw std::bad_alloc{};
+        return static_cast<T*>(allocated);
+    }
 
-			char const *head = p->data();
-			char const *tail = p->data() + p->size();
-			int radix = 10;
+    void deallocate(T*, std::size_t) noexcept { }
 
-	    switch (*head) {
-	    case '+':
-	    		++head;
-	    		break;
-	    case '-':
-					return std::nullopt;
-	    case '0':
-					if (head[1] != 'x')
-							break;
-					if (tail - head < 3)
-							return std::nullopt;
-					head += 2;
-					radix = 16;
-					break;
-	    default:
-					break;
-	    }
+    template<typename U>
+    bool operator == (arena_allocator<U> const& other) const noexcept {
+        return arena_ == other.get_arena();
+    }
 
-			T number;
-			auto const parsed = std::from_chars(head, tail, number, radix);
+    template<typename U>
+    bool operator != (arena_allocator<U> const& other) const noexcept {
+        return arena_ != other.get_arena();
+    }
 
-			if (parsed.ec == std::errc::invalid_argument || parsed.ptr != tail)
-					return std::nullopt;
+private:
+    arena* arena_;
+}; // arena_allocator
 
-			return {number};
-	}
 
-	template<typename T> std::optional<T> parse_signed() const noexcept {
-		std::string_view const *p = std::get_if<std::string_view>(&holder_);
-		if (p == nullptr)
-			return std::nullopt;
+// Arena stays in place while result owning it moves, tables keep pointer
+// to it and may grow after parse
+using arena_ptr = std::unique_ptr<arena>;
 
-		char const *head = p->data();
-		char const *tail = p->data() + p->size();
 
-		if (*head == '+')
-			++head;
+// Shared by lazy sections of one result
+struct lazy_context {
+    std::mutex mutex;
+    arena_ptr memory;
+    mode modes{mode::standard};
+    // First section failed to parse, written under mutex
+    std::atomic<int> failure{0};
+    std::atomic<unsigned> failure_line_no{0};
+}; // lazy_context
 
-		if (head == tail)
-			return std::nullopt;
 
-		T number;
-		auto const parsed = std::from_chars(head, tail, number);
+// Numbers of array parsed in columns mode follow the header. Nodes of items
+// are made only when array is read item by item, from source scanned again
+// right after opening brace
+struct number_column {
+    std::atomic<void*> items{nullptr};
+    arena* memory{nullptr};
+    char const* text{nullptr};
+}; // number_column
 
-		if (parsed.ec == std::errc::invalid_argument || parsed.ptr != tail)
-			return std::nullopt;
+} // namespace detail
 
-		return {number};
-	}
 
-	template<typename T> std::optional<std::vector<T>> parse_array() const {
-        array_ptr const* p = std::get_if<array_ptr>(&holder_);
-        if (p == nullptr)
-            return std::nullopt;
-        array const &data = *p->get();
-        std::vector<T> result;
-        result.reserve(data.size());
-        for(auto const& each: data) {
-            std::optional<T> const item = each | T{};
-            if(!item)
-                return std::nullopt;
-            result.emplace_back(*item);
-        }
-        return {result};
-    }
-}; // value
+namespace detail {
 
+constexpr std::uint64_t hash_mix(std::uint64_t h) noexcept {
+    h ^= h >> 32;
+    h *= 0xD6E8FEB86659FD93ull;
+    h ^= h >> 32;
+    return h;
+}
 
-inline value const value::none;
 
+// Little endian loads, compilers merge them into single load instruction
+constexpr std::uint64_t hash_load8(char const* b) noexcept {
+    return std::uint64_t(std::uint8_t(b[0]))
+         | std::uint64_t(std::uint8_t(b[1])) << 8
+         | std::uint64_t(std::uint8_t(b[2])) << 16
+         | std::uint64_t(std::uint8_t(b[3])) << 24
+         | std::uint64_t(std::uint8_t(b[4])) << 32
+         | std::uint64_t(std::uint8_t(b[5])) << 40
+         | std::uint64_t(std::uint8_t(b[6])) << 48
+         | std::uint64_t(std::uint8_t(b[7])) << 56;
+}
 
-struct result {
 
-    std::unique_ptr<char[]> source;
-    std::error_code error_code;
-    unsigned line_no{0};
-    value config;
+constexpr std::uint64_t hash_load4(char const* b) noexcept {
+    return std::uint64_t(std::uint8_t(b[0]))
+         | std::uint64_t(std::uint8_t(b[1])) << 8
+         | std::uint64_t(std::uint8_t(b[2])) << 16
+         | std::uint64_t(std::uint8_t(b[3])) << 24;
+}
 
-    result() = default;
-    result(result const&) = delete;
-    result& operator = (result const&) = delete;
-    result(result&&) = default;
-    result& operator = (result&&) = default;
 
-    explicit result(error e) noexcept:
-        error_code{int(e), confetti_category}
-    { }
+// Downcases ASCII letters in all 8 bytes of word at once
+constexpr std::uint64_t fold(std::uint64_t word) noexcept {
+    constexpr std::uint64_t ones = 0x0101010101010101ull;
+    std::uint64_t const heptets = word & (ones * 0x7F);
+    std::uint64_t const above_z = heptets + ones * (0x7F - 'Z');
+    std::uint64_t const from_a = heptets + ones * (0x80 - 'A');
+    std::uint64_t const upper = ~word & (from_a ^ above_z) & (ones * 0x80);
+    return word | (upper >> 2);
+}
 
-    explicit result(std::unique_ptr<char[]> source) noexcept:
-        source(std::move(source)), config{value::make_table()}
-    { }
 
-    explicit operator bool() const noexcept {
-        return !error_code;
+// Hashes key by 8 bytes words, tail is loaded overlapping previous word.
+// ASCII letters are folded, so hash is case insensitive
+constexpr std::uint32_t hash(std::string_view key) noexcept {
+    char const* const p = key.data();
+    std::size_t const n = key.size();
+    std::uint64_t h = 0x9E3779B97F4A7C15ull ^ n;
+    if(n >= 8) {
+        for(std::size_t i = 0; i + 8 < n; i += 8)
+            h = hash_mix(h ^ fold(hash_load8(p + i)));
+        h = hash_mix(h ^ fold(hash_load8(p + n - 8)));
+    } else if(n >= 4) {
+        h = hash_mix(h ^ fold(hash_load4(p) | hash_load4(p + n - 4) << 32));
+    } else if(n != 0) {
+        h = hash_mix(h ^ fold(std::uint64_t(std::uint8_t(p[0]))
+                              | std::uint64_t(std::uint8_t(p[n / 2])) << 8
+                              | std::uint64_t(std::uint8_t(p[n - 1])) << 16));
     }
-}; // result
+    return std::uint32_t(h);
+}
 
 
-namespace detail {
+// Case insensitive comparison for ASCII letters
+inline bool equal_folded(std::string_view lhs, std::string_view rhs) noexcept {
+    std::size_t const n = lhs.size();
+    if(n != rhs.size())
+        return false;
+    char const* const l = lhs.data();
+    char const* const r = rhs.data();
+    if(n >= 8) {
+        for(std::size_t i = 0; i + 8 < n; i += 8)
+            if(fold(hash_load8(l + i)) != fold(hash_load8(r + i)))
+                return false;
+        return fold(hash_load8(l + n - 8)) == fold(hash_load8(r + n - 8));
+    }
+    if(n >= 4)
+        return fold(hash_load4(l) | hash_load4(l + n - 4) << 32)
+            == fold(hash_load4(r) | hash_load4(r + n - 4) << 32);
+    for(std::size_t i = 0; i != n; ++i)
+        if(ascii::lower_case(l[i]) != ascii::lower_case(r[i]))
+            return false;
+    return true;
+}
 
-// clang-format off
-enum struct token {
-    undefined, end, opened_square_brace, closed_square_brace,
-    opened_figure_brace, closed_figure_brace, equal, comma, text,
-    unclosed_string
-}; // token
-// clang-format on
 
-class scaner {
+// Entries are kept contiguous in insertion order. Small tables are searched
+// by linear scan over hashes, bigger ones get open addressing index.
+template<typename Value> class basic_table {
 public:
-    scaner() noexcept = default;
-    scaner(scaner const&) noexcept = default;
-    scaner& operator = (scaner const&) noexcept = default;
-    explicit scaner(char* source): cursor_{source} { }
-    int line_no() const noexcept { return line_no_; }
-    char* head() noexcept { return head_; }
-    char* tail() noexcept { return tail_; }
+    using size_type = std::size_t;
 
-    std::string_view text() const noexcept {
-        return std::string_view{head_, std::size_t(tail_ - head_)};
-    }
+    struct entry {
+        std::string_view key;
+        Value value;
+    }; // entry
 
-    bool scan_byte_order_mark() {
-        switch(int(*cursor_)) {
-        case 0xEF:
-            ++cursor_;
-            if(int(*cursor_) != 0xBB)
-                return false;
-            ++cursor_;
-            if(int(*cursor_) != 0xBF)
-                return false;
-            return true;
-        case 0xFE:
-        case 0xFF:
-            return false;
-        default:
-            return true;
-        }
+    static constexpr std::uint32_t linear_limit = 16;
+
+    explicit basic_table(arena& a) noexcept: arena_{&a} { }
+    basic_table(basic_table const&) = delete;
+    basic_table& operator = (basic_table const&) = delete;
+
+    size_type size() const noexcept { return size_; }
+    entry* begin() noexcept { return entries_; }
+    entry* end() noexcept { return entries_ + size_; }
+    entry const* begin() const noexcept { return entries_; }
+    entry const* end() const noexcept { return entries_ + size_; }
+
+    std::uint32_t hash_of(entry const& e) const noexcept {
+        return hashes_[&e - entries_];
+    }
+
+    Value* find(std::string_view key, std::uint32_t h) noexcept {
+        std::uint32_t const found = lookup(key, h);
+        if(found == size_)
+            return nullptr;
+        return &entries_[found].value;
+    }
+
+    Value const* find(std::string_view key, std::uint32_t h) const noexcept {
+        std::uint32_t const found = lookup(key, h);
+        if(found == size_)
+            return nullptr;
+        return &entries_[found].value;
+    }
+
+    // nullptr if key exists or there is not enough memory
+    Value* insert(std::string_view key, std::uint32_t h, Value&& v) noexcept {
+        if(lookup(key, h) != size_)
+            return nullptr;
+        if(size_ == capacity_ && !grow())
+            return nullptr;
+        hashes_[size_] = h;
+        entry* inserted = new(entries_ + size_) entry{key, std::move(v)};
+        ++size_;
+        if(index_ != nullptr)
+            index(size_ - 1);
+        return &inserted->value;
+    }
+
+private:
+    arena* arena_;
+    std::uint32_t* hashes_{nullptr};
+    entry* entries_{nullptr};
+    std::uint32_t* index_{nullptr};
+    std::uint32_t size_{0};
+    std::uint32_t capacity_{0};
+    std::uint32_t index_mask_{0};
+
+    std::uint32_t lookup(std::string_view key, std::uint32_t h) const noexcept {
+        if(index_ == nullptr) {
+            for(std::uint32_t i = 0; i != size_; ++i)
+                if(hashes_[i] == h && equal_folded(entries_[i].key, key))
+                    return i;
+            return size_;
+        }
+        for(std::uint32_t slot = h & index_mask_;;
+            slot = (slot + 1) & index_mask_) {
+            std::uint32_t const i = index_[slot];
+            if(i == 0)
+                return size_;
+            if(hashes_[i - 1] == h && equal_folded(entries_[i - 1].key, key))
+                return i - 1;
+        }
+    }
+
+    void index(std::uint32_t i) noexcept {
+        std::uint32_t slot = hashes_[i] & index_mask_;
+        while(index_[slot] != 0)
+            slot = (slot + 1) & index_mask_;
+        index_[slot] = i + 1;
+    }
+
+    bool grow() noexcept {
+        std::uint32_t const capacity = capacity_ == 0 ? 4 : capacity_ * 2;
+        if(capacity < capacity_)
+            return false;
+        auto* hashes = static_cast<std::uint32_t*>(
+            arena_->allocate(sizeof(std::uint32_t) * capacity,
+                             alignof(std::uint32_t)));
+        auto* entries = static_cast<entry*>(
+            arena_->allocate(sizeof(entry) * capacity, alignof(entry)));
+        if(hashes == nullptr || entries == nullptr)
+            return false;
+        for(std::uint32_t i = 0; i != size_; ++i) {
+            hashes[i] = hashes_[i];
+            new(entries + i) entry{entries_[i].key, std::move(entries_[i].value)};
+        }
+        hashes_ = hashes;
+        entries_ = entries;
+        capacity_ = capacity;
+        if(capacity_ <= linear_limit)
+            return true;
+        std::uint32_t const slots = capacity_ * 2;
+        auto* slots_memory = static_cast<std::uint32_t*>(
+            arena_->allocate(sizeof(std::uint32_t) * slots,
+                             alignof(std::uint32_t)));
+        if(slots_memory == nullptr) {
+            index_ = nullptr;
+            return true;
+        }
+        std::memset(slots_memory, 0, sizeof(std::uint32_t) * slots);
+        index_ = slots_memory;
+        index_mask_ = slots - 1;
+        for(std::uint32_t i = 0; i != size_; ++i)
+            index(i);
+        return true;
+    }
+}; // basic_table
+
+} // namespace detail
+
+
+namespace detail {
+
+inline std::optional<bool> parse_bool(std::string_view text) noexcept {
+    using ascii::lower_case;
+    char const* cc = text.data();
+    switch(text.size()) {
+    case 4:
+        if(lower_case(cc[0]) == 't' && lower_case(cc[1]) == 'r'
+           && lower_case(cc[2]) == 'u' && lower_case(cc[3]) == 'e')
+            return {true};
+        return std::nullopt;
+    case 5:
+        if(lower_case(cc[0]) == 'f' && lower_case(cc[1]) == 'a'
+           && lower_case(cc[2]) == 'l' && lower_case(cc[3]) == 's'
+           && lower_case(cc[4]) == 'e')
+            return {false};
+        return std::nullopt;
+    default:
+        return std::nullopt;
+    }
+}
+
+
+// All 8 bytes are ASCII digits
+constexpr bool eight_digits(std::uint64_t chunk) noexcept {
+    return ((chunk & 0xF0F0F0F0F0F0F0F0ull)
+            | (((chunk + 0x0606060606060606ull) & 0xF0F0F0F0F0F0F0F0ull) >> 4))
+        == 0x3333333333333333ull;
+}
+
+
+// Converts 8 digits loaded little endian: pairs, then quads, then halves
+// are combined by multiplications
+constexpr std::uint32_t eight_digits_value(std::uint64_t chunk) noexcept {
+    chunk -= 0x3030303030303030ull;
+    chunk = chunk * 10 + (chunk >> 8);
+    chunk = ((chunk & 0x000000FF000000FFull) * (100 + (1000000ull << 32))
+             + ((chunk >> 16) & 0x000000FF000000FFull)
+               * (1 + (10000ull << 32))) >> 32;
+    return std::uint32_t(chunk);
+}
+
+
+constexpr bool four_digits(std::uint32_t chunk) noexcept {
+    return ((chunk & 0xF0F0F0F0u)
+            | (((chunk + 0x06060606u) & 0xF0F0F0F0u) >> 4)) == 0x33333333u;
+}
+
+
+constexpr std::uint32_t four_digits_value(std::uint32_t chunk) noexcept {
+    chunk -= 0x30303030u;
+    chunk = chunk * 10 + (chunk >> 8);
+    return (chunk & 0xFF) * 100 + ((chunk >> 16) & 0xFF);
+}
+
+
+// Decimal digits with optional '_' between them. Runs of 8 and 4 digits
+// are converted at once while sum can not overflow, rest one by one
+inline bool parse_decimal(char const* head, char const* tail,
+                          std::uint64_t& number) noexcept {
+    char const* const begin = head;
+    if(head == tail)
+        return false;
+    std::uint64_t n = 0;
+    unsigned digits = 0;
+    for(;;) {
+        for(; tail - head >= 8 && digits <= 11; head += 8, digits += 8) {
+            std::uint64_t const chunk = hash_load8(head);
+            if(!eight_digits(chunk))
+                break;
+            n = n * 100000000 + eight_digits_value(chunk);
+        }
+        if(tail - head >= 4 && digits <= 15) {
+            auto const chunk = std::uint32_t(hash_load4(head));
+            if(four_digits(chunk)) {
+                n = n * 10000 + four_digits_value(chunk);
+                digits += 4;
+                head += 4;
+            }
+        }
+        for(; head != tail; ++head, ++digits) {
+            unsigned const d = unsigned(*head - '0');
+            if(d >= 10)
+                break;
+            if(digits >= 19
+               && n > (std::numeric_limits<std::uint64_t>::max() - d) / 10)
+                return false;
+            n = n * 10 + d;
+        }
+        if(head == tail)
+            break;
+        if(*head != '_' || head == begin || unsigned(head[-1] - '0') >= 10
+           || head + 1 == tail || unsigned(head[1] - '0') >= 10)
+            return false;
+        ++head;
+    }
+    number = n;
+    return true;
+}
+
+
+inline bool parse_hexadecimal(char const* head, char const* tail,
+                              std::uint64_t& number) noexcept {
+    if(head == tail)
+        return false;
+    std::uint64_t n = 0;
+    bool after_digit = false;
+    for(; head != tail; ++head) {
+        char const c = *head;
+        unsigned d;
+        if(unsigned(c - '0') < 10)
+            d = unsigned(c - '0');
+        else if(unsigned(ascii::lower_case(c) - 'a') < 6)
+            d = unsigned(ascii::lower_case(c) - 'a') + 10;
+        else if(c == '_' && after_digit && head + 1 != tail
+                && head[1] != '_') {
+            after_digit = false;
+            continue;
+        } else
+            return false;
+        if(n >> 60 != 0)
+            return false;
+        n = n << 4 | d;
+        after_digit = true;
+    }
+    number = n;
+    return true;
+}
+
+
+// Unsigned numbers may be hexadecimal with 0x prefix
+template<typename T>
+bool parse_integer(std::string_view text, T& number) noexcept {
+    static_assert(std::is_integral_v<T> && !std::is_same_v<T, bool>);
+    char const *head = text.data();
+    char const *tail = text.data() + text.size();
+
+    if(head != tail && *head == '+')
+        ++head;
+    bool const negative = head != tail && *head == '-';
+    std::uint64_t magnitude;
+
+    if constexpr(std::is_unsigned_v<T>) {
+        if(negative)
+            return false;
+        if(tail - head > 2 && head[0] == '0' && head[1] == 'x') {
+            if(!parse_hexadecimal(head + 2, tail, magnitude))
+                return false;
+        } else if(!parse_decimal(head, tail, magnitude)) {
+            return false;
+        }
+        if(magnitude > std::numeric_limits<T>::max())
+            return false;
+        number = T(magnitude);
+    } else {
+        if(negative)
+            ++head;
+        if(!parse_decimal(head, tail, magnitude))
+            return false;
+        std::uint64_t const limit =
+            std::uint64_t(std::numeric_limits<T>::max()) + negative;
+        if(magnitude > limit)
+            return false;
+        number = negative ? T(-static_cast<long long>(magnitude - 1) - 1)
+                          : T(magnitude);
+    }
+    return true;
+}
+
+
+template<typename T>
+std::optional<T> parse_unsigned(std::string_view text) noexcept {
+    T number;
+    if(!parse_integer(text, number))
+        return std::nullopt;
+    return {number};
+}
+
+
+template<typename T>
+std::optional<T> parse_signed(std::string_view text) noexcept {
+    T number;
+    if(!parse_integer(text, number))
+        return std::nullopt;
+    return {number};
+}
+
+
+template<typename T> struct real_traits;
+
+
+template<> struct real_traits<double> {
+    static constexpr std::uint64_t max_mantissa = std::uint64_t(1) << 53;
+    static constexpr int max_exponent = 22;
+    static constexpr double powers[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+}; // real_traits<double>
+
+
+template<> struct real_traits<float> {
+    static constexpr std::uint64_t max_mantissa = std::uint64_t(1) << 24;
+    static constexpr int max_exponent = 10;
+    static constexpr float powers[] = {
+        1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f
+    };
+}; // real_traits<float>
+
+
+// Decimal with mantissa and power of ten both exact in T needs single
+// rounding (Clinger's fast path). False when number should be converted
+// by the slow path, or is not a decimal at all
+template<typename T>
+bool parse_fast_real(char const* head, char const* tail, T& number) noexcept {
+    using traits = real_traits<T>;
+    bool const negative = head != tail && *head == '-';
+    if(negative)
+        ++head;
+    std::uint64_t mantissa = 0;
+    int digits = 0;
+    int exponent = 0;
+    bool any_digit = false;
+    for(; head != tail && unsigned(*head - '0') < 10; ++head) {
+        any_digit = true;
+        if(mantissa == 0 && *head == '0')
+            continue;
+        if(++digits > 19)
+            return false;
+        mantissa = mantissa * 10 + unsigned(*head - '0');
+    }
+    if(head != tail && *head == '.')
+        for(++head; head != tail && unsigned(*head - '0') < 10; ++head) {
+            any_digit = true;
+            --exponent;
+            if(mantissa == 0 && *head == '0')
+                continue;
+            if(++digits > 19)
+                return false;
+            mantissa = mantissa * 10 + unsigned(*head - '0');
+        }
+    if(!any_digit)
+        return false;
+    if(head != tail && (*head == 'e' || *head == 'E')) {
+        ++head;
+        bool const negative_exponent = head != tail && *head == '-';
+        if(head != tail && (*head == '-' || *head == '+'))
+            ++head;
+        if(head == tail)
+            return false;
+        int written = 0;
+        for(; head != tail && unsigned(*head - '0') < 10; ++head) {
+            if(written > 100000)
+                return false;
+            written = written * 10 + (*head - '0');
+        }
+        exponent += negative_exponent ? -written : written;
+    }
+    if(head != tail || mantissa > traits::max_mantissa)
+        return false;
+
+    T converted = T(0);
+    if(mantissa != 0 && exponent < 0) {
+        if(-exponent > traits::max_exponent)
+            return false;
+        converted = T(mantissa) / traits::powers[-exponent];
+    } else if(mantissa != 0) {
+        // Small mantissa takes some of exponent while it stays exact
+        for(; exponent > traits::max_exponent; --exponent) {
+            mantissa *= 10;
+            if(mantissa > traits::max_mantissa)
+                return false;
+        }
+        converted = T(mantissa) * traits::powers[exponent];
+    }
+    number = negative ? -converted : converted;
+    return true;
+}
+
+
+// Terminated copy of number for strtod
+template<typename T>
+std::optional<T> parse_real_with_strtod(char const* head, char const* tail) {
+    char buffer[64];
+    std::string long_number;
+    std::size_t const n = std::size_t(tail - head);
+    char const* terminated = buffer;
+    if (n < sizeof(buffer)) {
+        std::memcpy(buffer, head, n);
+        buffer[n] = '\0';
+    } else {
+        long_number.assign(head, tail);
+        terminated = long_number.data();
+    }
+    char *endptr;
+    T number;
+    if constexpr(std::is_same_v<T, float>)
+        number = std::strtof(terminated, &endptr);
+    else
+        number = std::strtod(terminated, &endptr);
+    if (endptr != terminated + n)
+        return std::nullopt;
+    return {number};
+}
+
+
+// Locale independent, strtod is left for overflows and compilers without
+// floating point from_chars
+template<typename T = double>
+std::optional<T> parse_real(std::string_view text) {
+    if (text.empty())
+        return std::nullopt;
+
+    char const *head = text.data();
+    char const *tail = text.data() + text.size();
+
+    if (*head == '+')
+        ++head;
+
+    T number;
+    if (parse_fast_real(head, tail, number))
+        return {number};
+
+#if defined(__cpp_lib_to_chars) || defined(_MSC_VER)
+    bool const negative = head != tail && *head == '-';
+    char const* digits = negative ? head + 1 : head;
+    auto format = std::chars_format::general;
+    if (tail - digits > 2 && digits[0] == '0'
+        && (digits[1] == 'x' || digits[1] == 'X')) {
+        digits += 2;
+        // from_chars takes its own sign, "0x-5" is not a number
+        if (*digits == '-' || *digits == '+')
+            return std::nullopt;
+        format = std::chars_format::hex;
+    } else {
+        digits = head;
+    }
+    auto const parsed = std::from_chars(digits, tail, number, format);
+    if (parsed.ptr != tail || parsed.ec == std::errc::invalid_argument)
+        return std::nullopt;
+    if (parsed.ec == std::errc::result_out_of_range)
+        return parse_real_with_strtod<T>(head, tail);
+    if (format == std::chars_format::hex && negative)
+        number = -number;
+    return {number};
+#else
+    return parse_real_with_strtod<T>(head, tail);
+#endif
+}
+
+
+// Conversions of scalar made once at parse time
+struct typed_scalar {
+    char const* text;
+    std::uint64_t integer;
+    double real;
+}; // typed_scalar
+
+} // namespace detail
+
+
+// Key with hash computed ahead, at compile time when declared constexpr:
+//     static constexpr confetti::key threads{"threads"};
+class key {
+public:
+    template<std::size_t N>
+    constexpr key(char const (&name)[N]) noexcept:
+        name_{name, N - 1}, hash_{detail::hash(name_)}
+    { }
+
+    constexpr explicit key(std::string_view name) noexcept:
+        name_{name}, hash_{detail::hash(name)}
+    { }
+
+    constexpr std::string_view name() const noexcept { return name_; }
+    constexpr std::uint32_t hash() const noexcept { return hash_; }
+
+private:
+    std::string_view name_;
+    std::uint32_t hash_;
+}; // key
+
+
+namespace literals {
+
+    constexpr key operator""_key(char const* name, std::size_t n) noexcept {
+        return key{std::string_view{name, n}};
+    }
+
+} // namespace literals
+
+
+// Read-only view of contiguous numbers
+template<typename T> class span {
+public:
+    using value_type = std::remove_cv_t<T>;
+    using size_type = std::size_t;
+    using iterator = T*;
+
+    constexpr span() noexcept = default;
+    constexpr span(T* data, size_type size) noexcept:
+        data_{data}, size_{size}
+    { }
+
+    constexpr T* data() const noexcept { return data_; }
+    constexpr size_type size() const noexcept { return size_; }
+    constexpr bool empty() const noexcept { return size_ == 0; }
+    constexpr T* begin() const noexcept { return data_; }
+    constexpr T* end() const noexcept { return data_ + size_; }
+    constexpr T& operator [] (size_type i) const noexcept { return data_[i]; }
+
+private:
+    T* data_{nullptr};
+    size_type size_{0};
+}; // span
+
+
+class value;
+
+namespace detail {
+
+    struct lazy_section;
+    value& materialize(lazy_section& section) noexcept;
+    std::string_view scan_item(char const*& cursor) noexcept;
+    class parallel_parser;
+    class differ;
+    class binder;
+    class image_writer;
+
+} // namespace detail
+
+
+class value {
+    using table = detail::basic_table<value>;
+    friend class detail::parallel_parser;
+    friend class detail::differ;
+    friend class detail::binder;
+    friend class detail::image_writer;
+public:
+    using size_type = size_t;
+
+    static value const none;
+
+    static value make(std::string_view const& sv) noexcept {
+        value made;
+        made.kind_ = kind::single;
+        made.size_ = std::uint32_t(sv.size());
+        made.text_ = sv.data();
+        return made;
+    }
+
+    // Converts text ahead to all possible types
+    static value make_typed(detail::arena& a,
+                            std::string_view const& sv) noexcept {
+        auto* typed = a.create<detail::typed_scalar>();
+        if(typed == nullptr)
+            return value{};
+        value made;
+        made.kind_ = kind::typed;
+        made.size_ = std::uint32_t(sv.size());
+        made.typed_ = typed;
+        typed->text = sv.data();
+        typed->integer = 0;
+        typed->real = 0.;
+        if(auto const n = detail::parse_signed<long long>(sv)) {
+            made.conversions_ |= as_signed;
+            typed->integer = std::uint64_t(*n);
+        }
+        if(auto const n = detail::parse_unsigned<unsigned long long>(sv)) {
+            made.conversions_ |= as_unsigned;
+            typed->integer = *n;
+        }
+        try {
+            if(auto const n = detail::parse_real(sv)) {
+                made.conversions_ |= as_real;
+                typed->real = *n;
+            }
+        } catch(std::bad_alloc const&) {
+            return value{};
+        }
+        if(auto const b = detail::parse_bool(sv))
+            made.conversions_ |= *b ? as_true : as_false;
+        return made;
+    }
+
+    // Moves items into contiguous run inside arena
+    static value make_array(detail::arena& a, value* items,
+                            size_type n) noexcept {
+        value made;
+        made.kind_ = kind::array;
+        if(n == 0)
+            return made;
+        void* allocated = a.allocate(sizeof(value) * n, alignof(value));
+        if(allocated == nullptr)
+            return value{};
+        value* run = static_cast<value*>(allocated);
+        for(size_type i = 0; i != n; ++i)
+            new(run + i) value{std::move(items[i])};
+        made.size_ = std::uint32_t(n);
+        made.items_ = run;
+        return made;
+    }
+
+    // Array keeping only numbers of items when all of them are integers or
+    // all are reals exact in double, none otherwise. Numbers are parsed into
+    // scratch first, text is the source of items right after opening brace
+    static value make_column(detail::arena& a, value const* items,
+                             size_type n, std::uint64_t* scratch,
+                             char const* text) noexcept {
+        if(n == 0 || !may_be_column(items[0]))
+            return value{};
+        std::uint8_t const stored = parse_column(items, n, scratch);
+        if(stored == 0)
+            return value{};
+        void* allocated = a.allocate(sizeof(detail::number_column)
+                                     + sizeof(std::uint64_t) * n,
+                                     alignof(detail::number_column));
+        if(allocated == nullptr)
+            return value{};
+        auto* const column = new(allocated) detail::number_column{};
+        column->memory = &a;
+        column->text = text;
+        std::memcpy(static_cast<char*>(allocated)
+                    + sizeof(detail::number_column),
+                    scratch, sizeof(std::uint64_t) * n);
+        value made;
+        made.kind_ = kind::array;
+        made.size_ = std::uint32_t(n);
+        made.column_ = column;
+        made.conversions_ = stored;
+        return made;
+    }
+
+    static value make_table(detail::arena& a) noexcept {
+        value made;
+        made.table_ = a.create<table>(a);
+        if(made.table_ != nullptr)
+            made.kind_ = kind::table;
+        return made;
+    }
+
+    // Section parsed on first lookup through enclosing table
+    static value make_lazy(detail::lazy_section* section) noexcept {
+        value made;
+        made.lazy_ = section;
+        made.kind_ = kind::lazy;
+        return made;
+    }
+
+    value() noexcept = default;
+    value(value const &) = delete;
+    value &operator=(value const &) = delete;
+    value(value &&) noexcept = default;
+    value &operator=(value &&) noexcept = default;
+
+    bool is_none() const noexcept {
+        return kind_ == kind::none;
+    }
+
+    bool is_single() const noexcept {
+        return kind_ == kind::single || kind_ == kind::typed;
+    }
+
+    bool is_array() const noexcept {
+        return kind_ == kind::array;
+    }
+
+    // Array parsed in columns mode whose items are all integers (int64_t)
+    // or all reals (double), empty span otherwise
+    template<typename T> span<T const> as_span() const noexcept {
+        static_assert(std::is_same_v<T, std::int64_t>
+                      || std::is_same_v<T, double>,
+                      "Columns are of std::int64_t or double");
+        constexpr std::uint8_t stored =
+            std::is_same_v<T, double> ? as_real : as_signed;
+        if(kind_ != kind::array || conversions_ != stored)
+            return {};
+        return {reinterpret_cast<T const*>(column_ + 1), size_};
+    }
+
+    // Reuses capacity of out (and of its strings), out is cleared on failure
+    template<typename T> bool read_into(std::vector<T>& out) const {
+        if(kind_ != kind::array) {
+            out.clear();
+            return false;
+        }
+        out.resize(size_);
+        if(size_ != 0 && !convert_items(out)) {
+            out.clear();
+            return false;
+        }
+        return true;
+    }
+
+    // Converts items into first size() elements of out, fails when out
+    // is shorter. Items before failed one are already written
+    template<typename T> bool copy_to(span<T> out) const {
+        if(kind_ != kind::array || out.size() < size_)
+            return false;
+        return size_ == 0 || convert_items(out);
+    }
+
+    template<typename T> class range;
+
+    // Items are converted on dereference, range does not allocate
+    template<typename T> range<T> as_range() const noexcept;
+
+    bool is_table() const noexcept {
+        return kind_ == kind::table;
+    }
+
+    size_type size() const noexcept {
+        switch(kind_) {
+        case kind::array:
+            return size_;
+        case kind::table:
+            return table_->size();
+        default:
+            return 0;
+        }
+    }
+
+    bool empty() const noexcept {
+        return size() == 0;
+    }
+
+    class iterator;
+
+    // Key and value pairs of table in file order, items of array with empty
+    // keys. Scalars have no items
+    iterator begin() const noexcept;
+    iterator end() const noexcept;
+
+    value const& operator [] (size_type i) const noexcept {
+        if (kind_ != kind::array || i >= size_)
+            return none;
+        if(conversions_ == 0)
+            return items_[i];
+        value const* const run = items();
+        if(run == nullptr)
+            return none;
+        return run[i];
+    }
+
+    value const& operator [] (std::string_view const& name) const noexcept {
+        if (kind_ != kind::table)
+            return none;
+        value const* found = table_->find(name, detail::hash(name));
+        if (found == nullptr)
+            return none;
+        return found->resolved();
+    }
+
+    template<std::size_t N>
+    value const& operator [] (char const (&name)[N]) const noexcept {
+        return (*this)[std::string_view{name, N - 1}];
+    }
+
+    value const& operator [] (key const& k) const noexcept {
+        if (kind_ != kind::table)
+            return none;
+        value const* found = table_->find(k.name(), k.hash());
+        if (found == nullptr)
+            return none;
+        return found->resolved();
+    }
+
+    value *insert(std::string_view const &name, value &&value) noexcept {
+        if (kind_ != kind::table)
+            return nullptr;
+        return table_->insert(name, detail::hash(name), std::move(value));
+    }
+
+    value* find(std::string_view const& name) noexcept {
+        if (kind_ != kind::table)
+            return nullptr;
+        value* found = table_->find(name, detail::hash(name));
+        if (found == nullptr)
+            return nullptr;
+        return &found->resolved();
+    }
+
+    template <std::size_t N> value* find(char const (&name)[N]) noexcept {
+            return find(std::string_view{name, N - 1});
+    }
+
+    value* find(key const& k) noexcept {
+        if (kind_ != kind::table)
+            return nullptr;
+        value* found = table_->find(k.name(), k.hash());
+        if (found == nullptr)
+            return nullptr;
+        return &found->resolved();
+    }
+
+    bool contains(std::string_view const &name) const noexcept {
+        if (kind_ != kind::table)
+            return false;
+        return table_->find(name, detail::hash(name)) != nullptr;
+    }
+
+    template <std::size_t N>
+    bool contains(char const (&name)[N]) const noexcept {
+        return contains(std::string_view{name, N - 1});
+    }
+
+    bool contains(key const& k) const noexcept {
+        if (kind_ != kind::table)
+            return false;
+        return table_->find(k.name(), k.hash()) != nullptr;
+    }
+
+    std::optional<bool> operator | (bool bydefault) const noexcept {
+        if(kind_ == kind::none)
+            return {bydefault};
+        if(kind_ == kind::typed) {
+            if(conversions_ & as_true)
+                return {true};
+            if(conversions_ & as_false)
+                return {false};
+            return std::nullopt;
+        }
+        if(kind_ != kind::single)
+            return std::nullopt;
+        return detail::parse_bool(single());
+    }
+
+    std::optional<int> operator | (int bydefault) const noexcept {
+        if(kind_ == kind::none)
+            return {bydefault};
+        return to_signed<int>();
+    }
+
+    std::optional<unsigned> operator | (unsigned bydefault) const noexcept {
+        if(kind_ == kind::none)
+            return {bydefault};
+        return to_unsigned<unsigned>();
+    }
+
+    std::optional<long long> operator | (long long bydefault) const noexcept {
+        if(kind_ == kind::none)
+            return {bydefault};
+        return to_signed<long long>();
+    }
+
+    std::optional<unsigned long long>
+    operator | (unsigned long long bydefault) const noexcept {
+        if(kind_ == kind::none)
+            return {bydefault};
+        return to_unsigned<unsigned long long>();
+    }
+
+    std::optional<double> operator | (double bydefault) const {
+        if(kind_ == kind::none)
+            return {bydefault};
+        if(kind_ == kind::typed) {
+            if(conversions_ & as_real)
+                return {typed_->real};
+            return std::nullopt;
+        }
+        if(kind_ != kind::single)
+            return std::nullopt;
+        return detail::parse_real(single());
+    }
+
+    std::optional<float> operator | (float bydefault) const {
+        if(kind_ == kind::none)
+            return {bydefault};
+        if(!is_single())
+            return std::nullopt;
+        return detail::parse_real<float>(single());
+    }
+
+    std::optional<std::string_view>
+    operator | (std::string_view const& bydefault) const noexcept {
+        if(kind_ == kind::none)
+            return {bydefault};
+        if (!is_single())
+            return std::nullopt;
+        std::string_view const text = single();
+
+        return {text};
+    }
+
+    std::optional<std::string> operator | (char const* bydefault) const {
+        if(kind_ == kind::none)
+            return {std::string{bydefault}};
+        if (!is_single())
+            return std::nullopt;
+        std::string_view const text = single();
+
+        return {std::string{text.begin(), text.end()}};
+    }
+
+    std::optional<std::string>
+    operator | (std::string const& bydefault) const {
+        if(kind_ == kind::none)
+            return {bydefault};
+        if (!is_single())
+            return std::nullopt;
+        std::string_view const text = single();
+
+        return {std::string{text.begin(), text.end()}};
+    }
+
+    std::optional<std::vector<bool>>
+    operator | (std::vector<bool> bydefault) const {
+        if(kind_ == kind::none)
+            return {std::move(bydefault)};
+        return parse_array<bool>();
+    }
+
+    std::optional<std::vector<int>>
+    operator | (std::vector<int> bydefault) const {
+        if(kind_ == kind::none)
+            return {std::move(bydefault)};
+        return parse_array<int>();
+    }
+
+    std::optional<std::vector<unsigned>>
+    operator | (std::vector<unsigned> const& bydefault) const {
+        if(kind_ == kind::none)
+            return {std::move(bydefault)};
+        return parse_array<unsigned>();
+    }
+
+    std::optional<std::vector<long long>>
+    operator | (std::vector<long long> bydefault) const {
+        if(kind_ == kind::none)
+            return {std::move(bydefault)};
+        return parse_array<long long>();
+    }
+
+    std::optional<std::vector<unsigned long long>>
+    operator | (std::vector<unsigned long long> bydefault) const {
+        if(kind_ == kind::none)
+            return {std::move(bydefault)};
+        return parse_array<unsigned long long>();
+    }
+
+    std::optional<std::vector<double>>
+    operator | (std::vector<double> bydefault) const {
+        if(kind_ == kind::none)
+            return {std::move(bydefault)};
+        return parse_array<double>();
+    }
+
+    std::optional<std::vector<float>>
+    operator | (std::vector<float> bydefault) const {
+        if(kind_ == kind::none)
+            return {std::move(bydefault)};
+        return parse_array<float>();
+    }
+
+    std::optional<std::vector<std::string_view>>
+    operator | (std::vector<std::string_view> bydefault) const {
+        if(kind_ == kind::none)
+            return {std::move(bydefault)};
+        return parse_array<std::string_view>();
+    }
+
+    std::optional<std::vector<std::string>>
+    operator | (std::vector<std::string> bydefault) const {
+        if(kind_ == kind::none)
+            return {std::move(bydefault)};
+        return parse_array<std::string>();
+    }
+
+private:
+
+    enum struct kind : std::uint8_t {
+        none, single, typed, array, table, lazy
+    };
+
+    enum conversion : std::uint8_t {
+        as_signed = 1, as_unsigned = 2, as_real = 4, as_true = 8, as_false = 16
+    };
+
+    // 16 bytes node: arrays are contiguous runs of nodes
+    union {
+        char const* text_{nullptr};
+        detail::typed_scalar const* typed_;
+        value* items_;
+        detail::number_column* column_;
+        table* table_;
+        detail::lazy_section* lazy_;
+    };
+    std::uint32_t size_{0};
+    kind kind_{kind::none};
+    std::uint8_t conversions_{0};
+
+    value& resolved() noexcept {
+        if(kind_ == kind::lazy)
+            return detail::materialize(*lazy_);
+        return *this;
+    }
+
+    value const& resolved() const noexcept {
+        if(kind_ == kind::lazy)
+            return detail::materialize(*lazy_);
+        return *this;
+    }
+
+    static bool may_be_column(value const& first) noexcept {
+        if(first.kind_ != kind::single && first.kind_ != kind::typed)
+            return false;
+        std::string_view const text = first.single();
+        if(text.empty())
+            return false;
+        char const c = text.front();
+        return (c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.'
+            || c == 'i' || c == 'I' || c == 'n' || c == 'N';
+    }
+
+    // Numbers go to scratch as bits, returns kind of column or zero.
+    // Hexadecimal and integers from 2^53 on might not be exact as reals,
+    // so they are left to items
+    static std::uint8_t parse_column(value const* items, size_type n,
+                                     std::uint64_t* numbers) noexcept {
+        bool integers = true;
+        for(size_type i = 0; i != n && integers; ++i) {
+            std::int64_t integer;
+            if(!items[i].is_single()
+               || !detail::parse_integer(items[i].single(), integer))
+                integers = false;
+            else
+                numbers[i] = std::uint64_t(integer);
+        }
+        if(integers)
+            return as_signed;
+        try {
+            for(size_type i = 0; i != n; ++i) {
+                if(!items[i].is_single())
+                    return 0;
+                std::string_view const text = items[i].single();
+                if(text.find_first_of("xX") != std::string_view::npos)
+                    return 0;
+                auto const real = detail::parse_real(text);
+                if(!real)
+                    return 0;
+                constexpr double exact = double(std::uint64_t{1} << 53);
+                if(text.find_first_of(".eEiInN") == std::string_view::npos
+                   && (*real <= -exact || *real >= exact))
+                    return 0;
+                std::memcpy(&numbers[i], &*real, sizeof(double));
+            }
+        } catch(std::bad_alloc const&) {
+            return 0;
+        }
+        return as_real;
+    }
+
+    // Arrays only, nullptr when nodes of column can not be made
+    value const* items() const noexcept {
+        if(conversions_ == 0)
+            return items_;
+        if(void* made = column_->items.load(std::memory_order_acquire))
+            return static_cast<value const*>(made);
+        return make_column_items();
+    }
+
+    // Items keep their text in source, as in other modes. Racing readers
+    // keep nodes published first
+    value const* make_column_items() const noexcept {
+        void* const block = detail::arena::allocate_block(sizeof(value) * size_);
+        if(block == nullptr)
+            return nullptr;
+        value* const nodes = static_cast<value*>(block);
+        char const* cursor = column_->text;
+        for(size_type i = 0; i != size_; ++i)
+            new(nodes + i) value{make(detail::scan_item(cursor))};
+        void* published = nullptr;
+        if(!column_->items.compare_exchange_strong(published, block,
+                                                   std::memory_order_acq_rel,
+                                                   std::memory_order_acquire)) {
+            detail::arena::free_block(block);
+            return static_cast<value const*>(published);
+        }
+        column_->memory->keep_block(block);
+        return nodes;
+    }
+
+    std::string_view single() const noexcept {
+        if(kind_ == kind::typed)
+            return std::string_view{typed_->text, size_};
+        return std::string_view{text_, size_};
+    }
+
+    template<typename T> std::optional<T> to_unsigned() const noexcept {
+        if(kind_ == kind::typed) {
+            if(!(conversions_ & as_unsigned)
+               || typed_->integer > std::numeric_limits<T>::max())
+                return std::nullopt;
+            return {T(typed_->integer)};
+        }
+        if(kind_ != kind::single)
+            return std::nullopt;
+        return detail::parse_unsigned<T>(single());
+    }
+
+    template<typename T> std::optional<T> to_signed() const noexcept {
+        if(kind_ == kind::typed) {
+            auto const n = static_cast<long long>(typed_->integer);
+            if(!(conversions_ & as_signed)
+               || n < std::numeric_limits<T>::min()
+               || n > std::numeric_limits<T>::max())
+                return std::nullopt;
+            return {T(n)};
+        }
+        if(kind_ != kind::single)
+            return std::nullopt;
+        return detail::parse_signed<T>(single());
+    }
+
+	template<typename T> std::optional<std::vector<T>> parse_array() const {
+        std::vector<T> result;
+        if(!read_into(result))
+            return std::nullopt;
+        return {std::move(result)};
+    }
+
+    template<typename T> bool convert(T& converted) const {
+        if constexpr(std::is_integral_v<T> && !std::is_same_v<T, bool>) {
+            if(kind_ == kind::single)
+                return detail::parse_integer(single(), converted);
+        }
+        if constexpr(std::is_same_v<T, std::string>) {
+            // Assigning keeps capacity of reused string
+            if(!is_single())
+                return false;
+            converted.assign(single());
+            return true;
+        } else {
+            std::optional<T> const item = *this | T{};
+            if(!item)
+                return false;
+            converted = *item;
+            return true;
+        }
+    }
+
+    // Numbers are written in place, without optional per item
+    template<typename Output> bool convert_items(Output& out) const {
+        using item_type = std::decay_t<decltype(out[0])>;
+        if constexpr(std::is_same_v<item_type, double>) {
+            if(auto const column = as_span<double>(); !column.empty()) {
+                std::copy(column.begin(), column.end(), &out[0]);
+                return true;
+            }
+        }
+        if constexpr(std::is_integral_v<item_type>
+                     && std::is_signed_v<item_type>) {
+            // Column items passed the same check in int64 range
+            auto const column = as_span<std::int64_t>();
+            if(!column.empty()) {
+                for(size_type i = 0; i != column.size(); ++i) {
+                    if(column[i] < std::numeric_limits<item_type>::min()
+                       || column[i] > std::numeric_limits<item_type>::max())
+                        return false;
+                    out[i] = item_type(column[i]);
+                }
+                return true;
+            }
+        }
+        value const* const run = items();
+        if(run == nullptr)
+            return false;
+        if constexpr(std::is_same_v<Output, std::vector<bool>>) {
+            for(size_type i = 0; i != size_; ++i) {
+                std::optional<bool> const item = run[i] | false;
+                if(!item)
+                    return false;
+                out[i] = *item;
+            }
+            return true;
+        } else {
+            for(size_type i = 0; i != size_; ++i)
+                if(!run[i].convert(out[i]))
+                    return false;
+            return true;
+        }
+    }
+}; // value
+
+
+inline value const value::none;
+
+
+class value::iterator {
+public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type = std::pair<std::string_view, value const&>;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = value_type;
+
+    iterator() noexcept = default;
+    explicit iterator(table::entry const* entry) noexcept: entry_{entry} { }
+    explicit iterator(value const* item) noexcept: item_{item} { }
+
+    // Lazy section is parsed when reached
+    value_type operator * () const noexcept {
+        if(entry_ != nullptr)
+            return {entry_->key, entry_->value.resolved()};
+        return {std::string_view{}, *item_};
+    }
+
+    iterator& operator ++ () noexcept {
+        if(entry_ != nullptr)
+            ++entry_;
+        else
+            ++item_;
+        return *this;
+    }
+
+    iterator operator ++ (int) noexcept {
+        iterator const previous = *this;
+        ++*this;
+        return previous;
+    }
+
+    bool operator == (iterator const& other) const noexcept {
+        return entry_ == other.entry_ && item_ == other.item_;
+    }
+
+    bool operator != (iterator const& other) const noexcept {
+        return !(*this == other);
+    }
+
+private:
+    table::entry const* entry_{nullptr};
+    value const* item_{nullptr};
+}; // value::iterator
+
+
+inline value::iterator value::begin() const noexcept {
+    switch(kind_) {
+    case kind::array:
+        return iterator{items()};
+    case kind::table:
+        return iterator{table_->begin()};
+    default:
+        return iterator{};
+    }
+}
+
+
+inline value::iterator value::end() const noexcept {
+    switch(kind_) {
+    case kind::array:
+        if(value const* const run = items())
+            return iterator{run + size_};
+        return iterator{};
+    case kind::table:
+        return iterator{table_->end()};
+    default:
+        return iterator{};
+    }
+}
+
+
+template<typename T> class value::range {
+public:
+    class iterator {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = std::optional<T>;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = std::optional<T>;
+
+        iterator() noexcept = default;
+        explicit iterator(value const* item) noexcept: item_{item} { }
+
+        std::optional<T> operator * () const {
+            T converted{};
+            if(!item_->convert(converted))
+                return std::nullopt;
+            return {std::move(converted)};
+        }
+
+        iterator& operator ++ () noexcept { ++item_; return *this; }
+        iterator operator ++ (int) noexcept { return iterator{item_++}; }
+
+        bool operator == (iterator const& other) const noexcept {
+            return item_ == other.item_;
+        }
+
+        bool operator != (iterator const& other) const noexcept {
+            return item_ != other.item_;
+        }
+
+    private:
+        value const* item_{nullptr};
+    }; // iterator
+
+    range() noexcept = default;
+    range(value const* items, size_type size) noexcept:
+        items_{items}, size_{size}
+    { }
+
+    iterator begin() const noexcept { return iterator{items_}; }
+    iterator end() const noexcept { return iterator{items_ + size_}; }
+    size_type size() const noexcept { return size_; }
+    bool empty() const noexcept { return size_ == 0; }
+
+private:
+    value const* items_{nullptr};
+    size_type size_{0};
+}; // value::range
+
+
+template<typename T>
+value::range<T> value::as_range() const noexcept {
+    if(kind_ != kind::array)
+        return {};
+    value const* const run = items();
+    if(run == nullptr)
+        return {};
+    return {run, size_};
+}
+
+
+static_assert(sizeof(value) == 16 || sizeof(void*) != 8);
+
+
+struct result {
+
+    detail::source_ptr source;
+    detail::arena_ptr arena;
+    std::unique_ptr<detail::lazy_context> lazy;
+    std::error_code error_code;
+    unsigned line_no{0};
+    value config;
+
+    result() = default;
+    result(result const&) = delete;
+    result& operator = (result const&) = delete;
+    result(result&&) = default;
+    result& operator = (result&&) = default;
+
+    explicit result(error e) noexcept:
+        error_code{int(e), confetti_category}
+    { }
+
+    explicit result(detail::source_ptr source) noexcept:
+        source(std::move(source)), arena{new(std::nothrow) detail::arena}
+    {
+        if(arena)
+            config = value::make_table(*arena);
+    }
+
+    // Parse error of lazy section found on its first lookup
+    std::error_code deferred_error() const noexcept {
+        if(!lazy)
+            return {};
+        int const code = lazy->failure.load(std::memory_order_acquire);
+        return code == 0 ? std::error_code{} : make_error_code(error(code));
+    }
+
+    unsigned deferred_line_no() const noexcept {
+        if(!lazy || lazy->failure.load(std::memory_order_acquire) == 0)
+            return 0;
+        return lazy->failure_line_no.load(std::memory_order_relaxed);
+    }
+
+    explicit operator bool() const noexcept {
+        return !error_code && !deferred_error();
+    }
+}; // result
+
+
+enum struct change_kind {
+    added, removed, changed
+}; // change_kind
+
+
+// Path is dotted for tables and bracketed for arrays: "server.ports[1]".
+// Values belong to compared results
+struct change {
+    change_kind kind;
+    std::string path;
+    value const* before;
+    value const* after;
+}; // change
+
+
+namespace detail {
+
+// Case sensitive counterpart of hash for scalar texts
+inline std::uint64_t hash_bytes(std::string_view text,
+                                std::uint64_t h) noexcept {
+    char const* const p = text.data();
+    std::size_t const n = text.size();
+    h ^= n;
+    std::size_t i = 0;
+    for(; i + 8 <= n; i += 8)
+        h = hash_mix(h ^ hash_load8(p + i));
+    std::uint64_t tail = 0;
+    for(std::size_t shift = 0; i != n; ++i, shift += 8)
+        tail |= std::uint64_t(std::uint8_t(p[i])) << shift;
+    return hash_mix(h ^ tail);
+}
+
+
+class differ {
+public:
+    explicit differ(std::vector<change>& changes) noexcept:
+        changes_{changes}
+    { }
+
+    // Entries of tables are summed, so order of keys and sections does not
+    // matter; comments, spacing and quoting are gone after parse already
+    static std::uint64_t fingerprint(value const& v) noexcept {
+        value const& resolved = v.resolved();
+        switch(resolved.kind_) {
+        case value::kind::single:
+        case value::kind::typed:
+            return hash_single(resolved.single());
+        case value::kind::array: {
+            std::uint64_t h = 0xA0761D6478BD642Full ^ resolved.size_;
+            if(resolved.conversions_ != 0) {
+                // Texts of column items are hashed without making their nodes
+                char const* cursor = resolved.column_->text;
+                for(std::uint32_t i = 0; i != resolved.size_; ++i)
+                    h = hash_mix(h ^ hash_single(scan_item(cursor))) + i;
+                return h;
+            }
+            for(std::uint32_t i = 0; i != resolved.size_; ++i)
+                h = hash_mix(h ^ fingerprint(resolved[i])) + i;
+            return h;
+        }
+        case value::kind::table: {
+            std::uint64_t sum = 0;
+            for(auto const& each: *resolved.table_)
+                sum += hash_mix(fingerprint(each.value)
+                                ^ std::uint64_t(hash(each.key)) << 32);
+            return hash_mix(sum ^ 0xE7037ED1A0B428DBull
+                            ^ resolved.table_->size());
+        }
+        default:
+            return 0x8EBC6AF09C88C6E3ull;
+        }
+    }
+
+    void compare(value const& before, value const& after) {
+        value const& b = before.resolved();
+        value const& a = after.resolved();
+        if(b.kind_ == value::kind::table && a.kind_ == value::kind::table)
+            return compare_tables(*b.table_, *a.table_);
+        if(b.kind_ == value::kind::array && a.kind_ == value::kind::array)
+            return compare_arrays(b, a);
+        if(b.is_single() && a.is_single() && b.single() == a.single())
+            return;
+        if(b.is_none() && a.is_none())
+            return;
+        report(change_kind::changed, &b, &a);
+    }
+
+private:
+    std::vector<change>& changes_;
+    std::string path_;
+
+    static std::uint64_t hash_single(std::string_view text) noexcept {
+        return hash_bytes(text, 0x51ED270B27B7F1D5ull);
+    }
+
+    void report(change_kind kind, value const* before, value const* after) {
+        changes_.push_back(change{kind, path_, before, after});
+    }
+
+    void enter(std::string_view key) {
+        if(!path_.empty())
+            path_ += '.';
+        path_ += key;
+    }
+
+    void enter(std::uint32_t i) {
+        path_ += '[';
+        path_ += std::to_string(i);
+        path_ += ']';
+    }
+
+    void compare_tables(value::table const& before, value::table const& after) {
+        std::size_t const length = path_.size();
+        for(auto const& each: before) {
+            enter(each.key);
+            value const* found = after.find(each.key, hash(each.key));
+            if(found == nullptr)
+                report(change_kind::removed, &each.value.resolved(), nullptr);
+            else
+                compare(each.value, *found);
+            path_.resize(length);
+        }
+        for(auto const& each: after) {
+            if(before.find(each.key, hash(each.key)) != nullptr)
+                continue;
+            enter(each.key);
+            report(change_kind::added, nullptr, &each.value.resolved());
+            path_.resize(length);
+        }
+    }
+
+    void compare_arrays(value const& before, value const& after) {
+        std::size_t const length = path_.size();
+        std::uint32_t const common = std::min(before.size_, after.size_);
+        for(std::uint32_t i = 0; i != common; ++i) {
+            enter(i);
+            compare(before[i], after[i]);
+            path_.resize(length);
+        }
+        for(std::uint32_t i = common; i < before.size_; ++i) {
+            enter(i);
+            report(change_kind::removed, &before[i], nullptr);
+            path_.resize(length);
+        }
+        for(std::uint32_t i = common; i < after.size_; ++i) {
+            enter(i);
+            report(change_kind::added, nullptr, &after[i]);
+            path_.resize(length);
+        }
+    }
+}; // differ
+
+} // namespace detail
+
+
+// Changes of sections, keys, inline tables and array items in file order
+// of before, then additions in file order of after
+inline std::vector<change> diff(result const& before, result const& after) {
+    std::vector<change> changes;
+    detail::differ{changes}.compare(before.config, after.config);
+    return changes;
+}
+
+
+// Equal for configs with the same content however formatted or ordered
+inline std::uint64_t fingerprint(value const& config) noexcept {
+    return detail::differ::fingerprint(config);
+}
+
+
+inline std::uint64_t fingerprint(result const& parsed) noexcept {
+    return detail::differ::fingerprint(parsed.config);
+}
+
+
+namespace detail {
+
+// Destination of value which key was just scanned by schema_handler
+struct field_target {
+    void* member{nullptr};
+    bool (*scalar)(void* member, std::string_view text){nullptr};
+    void (*array)(void* member){nullptr};
+    bool (*item)(void* member, std::string_view text){nullptr};
+    void const* fields{nullptr};
+    bool (*find)(void const* fields, void* object, std::string_view key,
+                 field_target& target){nullptr};
+}; // field_target
+
+
+template<typename T> struct is_vector: std::false_type { };
+template<typename T, typename A>
+struct is_vector<std::vector<T, A>>: std::true_type { };
+
+
+template<typename T> bool assign_text(void* member, std::string_view text) {
+    auto converted = value::make(text) | T{};
+    if(!converted)
+        return false;
+    *static_cast<T*>(member) = T(std::move(*converted));
+    return true;
+}
+
+
+template<typename T> void clear_items(void* member) {
+    static_cast<T*>(member)->clear();
+}
+
+
+template<typename T> bool append_text(void* member, std::string_view text) {
+    auto converted = value::make(text) | T{};
+    if(!converted)
+        return false;
+    static_cast<std::vector<T>*>(member)->push_back(T(std::move(*converted)));
+    return true;
+}
+
+} // namespace detail
+
+
+// Maps key of section to member of struct:
+//     confetti::field{"port", &server::port}
+// or to member bound by its own schema, for section or inline table:
+//     confetti::field{"server", &settings::server, server_schema}
+template<typename Struct, typename Member, typename Nested = void>
+struct field {
+    static constexpr bool borrows_text = Nested::borrows_text;
+
+    key name;
+    Member Struct::* member;
+    Nested fields;
+
+    constexpr field(key name, Member Struct::* member,
+                    Nested const& fields) noexcept:
+        name{name}, member{member}, fields{fields}
+    { }
+
+    void target(Struct& object, detail::field_target& t) const noexcept {
+        t.member = &(object.*member);
+        t.fields = &fields;
+        t.find = &Nested::find_target;
+    }
+}; // field
+
+
+template<typename Struct, typename Member>
+struct field<Struct, Member, void> {
+    static constexpr bool borrows_text =
+        std::is_same_v<Member, std::string_view>
+        || std::is_same_v<Member, std::vector<std::string_view>>;
+
+    key name;
+    Member Struct::* member;
+
+    constexpr field(key name, Member Struct::* member) noexcept:
+        name{name}, member{member}
+    { }
+
+    void target(Struct& object, detail::field_target& t) const noexcept {
+        t.member = &(object.*member);
+        if constexpr(detail::is_vector<Member>::value) {
+            t.array = &detail::clear_items<Member>;
+            t.item = &detail::append_text<typename Member::value_type>;
+        } else {
+            t.scalar = &detail::assign_text<Member>;
+        }
+    }
+}; // field
+
+
+template<typename Struct, typename Member>
+field(key, Member Struct::*) -> field<Struct, Member>;
+
+template<typename Struct, typename Member, typename Nested>
+field(key, Member Struct::*, Nested) -> field<Struct, Member, Nested>;
+
+
+// Fields of struct with key hashes computed at compile time when declared
+// constexpr:
+//     static constexpr confetti::schema server_schema{
+//         confetti::field{"host", &server::host},
+//         confetti::field{"port", &server::port}};
+template<typename Struct, typename... Fields> class schema {
+public:
+    using struct_type = Struct;
+    static constexpr std::size_t size = sizeof...(Fields);
+    static_assert(size != 0, "Schema should have fields");
+    // std::string_view members refer to parsed text
+    static constexpr bool borrows_text = (Fields::borrows_text || ...);
+
+    constexpr explicit schema(Fields... fields) noexcept:
+        fields_{fields...},
+        names_{fields.name.name()...},
+        hashes_{fields.name.hash()...}
+    { }
+
+    // Index of field or size if there is no such key
+    std::size_t find(std::string_view name, std::uint32_t h) const noexcept {
+        for(std::size_t i = 0; i != size; ++i)
+            if(hashes_[i] == h && detail::equal_folded(names_[i], name))
+                return i;
+        return size;
+    }
+
+    constexpr std::string_view name(std::size_t i) const noexcept {
+        return names_[i];
+    }
+
+    static bool find_target(void const* fields, void* object,
+                            std::string_view key,
+                            detail::field_target& t) noexcept {
+        auto const& self = *static_cast<schema const*>(fields);
+        std::size_t const i = self.find(key, detail::hash(key));
+        if(i == size)
+            return false;
+        t = detail::field_target{};
+        self.target(i, *static_cast<Struct*>(object), t,
+                    std::index_sequence_for<Fields...>{});
+        return true;
+    }
+
+private:
+    friend class detail::binder;
+
+    std::tuple<Fields...> fields_;
+    std::string_view names_[size];
+    std::uint32_t hashes_[size];
+
+    template<std::size_t... I>
+    void target(std::size_t i, Struct& object, detail::field_target& t,
+                std::index_sequence<I...>) const noexcept {
+        ((i == I && (std::get<I>(fields_).target(object, t), true)) || ...);
+    }
+}; // schema
+
+
+template<typename Struct, typename... Members, typename... Nested>
+schema(field<Struct, Members, Nested>...)
+    -> schema<Struct, field<Struct, Members, Nested>...>;
+
+
+// Key is name of field, empty when bound value is not a table
+struct binding_error {
+    std::string_view key;
+    std::error_code error_code;
+}; // binding_error
+
+
+namespace detail {
+
+class binder {
+public:
+    template<typename Struct, typename... Fields>
+    static void bind(value const& section, Struct& object,
+                     schema<Struct, Fields...> const& fields,
+                     std::vector<binding_error>& errors) {
+        constexpr std::size_t n = sizeof...(Fields);
+        value const& resolved = section.resolved();
+        if(resolved.kind_ == value::kind::none)
+            return;
+        if(resolved.kind_ != value::kind::table) {
+            errors.push_back(binding_error{
+                {}, make_error_code(error::invalid_parameter_value)});
+            return;
+        }
+        value::table const& table = *resolved.table_;
+        // Keys usually follow order of fields, so next field is tried first
+        std::size_t expected = 0;
+        for(auto const& each: table) {
+            std::uint32_t const h = table.hash_of(each);
+            std::size_t i = expected;
+            if(i == n || fields.hashes_[i] != h
+               || !equal_folded(fields.names_[i], each.key))
+                i = fields.find(each.key, h);
+            if(i == n)
+                continue;
+            if(!assign(fields, i, each.value.resolved(), object, errors,
+                       std::index_sequence_for<Fields...>{}))
+                errors.push_back(binding_error{
+                    fields.names_[i],
+                    make_error_code(error::invalid_parameter_value)});
+            expected = i + 1;
+        }
+    }
+
+private:
+    template<typename Struct, typename... Fields, std::size_t... I>
+    static bool assign(schema<Struct, Fields...> const& fields, std::size_t i,
+                       value const& v, Struct& object,
+                       std::vector<binding_error>& errors,
+                       std::index_sequence<I...>) {
+        bool assigned = false;
+        ((i == I && (assigned = convert(std::get<I>(fields.fields_), v,
+                                        object, errors), true)) || ...);
+        return assigned;
+    }
+
+    template<typename Struct, typename Member>
+    static bool convert(field<Struct, Member> const& f, value const& v,
+                        Struct& object, std::vector<binding_error>&) {
+        auto converted = v | Member{};
+        if(!converted)
+            return false;
+        object.*f.member = Member(std::move(*converted));
+        return true;
+    }
+
+    template<typename Struct, typename Member, typename Nested>
+    static bool convert(field<Struct, Member, Nested> const& f, value const& v,
+                        Struct& object, std::vector<binding_error>& errors) {
+        if(!v.is_table())
+            return false;
+        bind(v, object.*f.member, f.fields, errors);
+        return true;
+    }
+}; // binder
+
+} // namespace detail
+
+
+// Fills members of object which keys are present in section, others are
+// left as they are. Returns errors of all values of unexpected type
+template<typename Struct, typename... Fields>
+std::vector<binding_error> bind(value const& section, Struct& object,
+                                schema<Struct, Fields...> const& fields) {
+    std::vector<binding_error> errors;
+    detail::binder::bind(section, object, fields, errors);
+    return errors;
+}
+
+
+// Outcome of scan: stopped is set when handler requested early termination
+struct status {
+
+    std::error_code error_code;
+    unsigned line_no{0};
+    bool stopped{false};
+
+    status() = default;
+
+    explicit status(error e) noexcept:
+        error_code{int(e), confetti_category}
+    { }
+
+    explicit operator bool() const noexcept {
+        return !error_code;
+    }
+}; // status
+
+
+// Events of scan, derived handlers hide the ones they need. Any event
+// returning false stops scanning. Names are reported as written, strings
+// without quotes; views point into scanned text.
+struct handler {
+    bool on_section(std::string_view) { return true; }
+    bool on_key(std::string_view) { return true; }
+    bool on_scalar(std::string_view) { return true; }
+    bool on_array_begin() { return true; }
+    bool on_array_end() { return true; }
+    bool on_table_begin() { return true; }
+    bool on_table_end() { return true; }
+}; // handler
+
+
+namespace detail {
+
+// clang-format off
+enum struct token {
+    undefined, end, opened_square_brace, closed_square_brace,
+    opened_figure_brace, closed_figure_brace, equal, comma, text,
+    unclosed_string
+}; // token
+// clang-format on
+
+inline bool scan_byte_order_mark(char*& cursor) {
+    switch(int(*cursor)) {
+    case 0xEF:
+        ++cursor;
+        if(int(*cursor) != 0xBB)
+            return false;
+        ++cursor;
+        if(int(*cursor) != 0xBF)
+            return false;
+        return true;
+    case 0xFE:
+    case 0xFF:
+        return false;
+    default:
+        return true;
+    }
+}
+
+
+// Source is followed by source_padding zeros, search may look past '\0'
+struct padded_search {
+    static char const* line_end(char const* cursor) noexcept {
+        return find_line_end(cursor);
+    }
+
+    template<char Q>
+    static char const* string_end(char const* cursor) noexcept {
+        return find_string_end<Q>(cursor);
+    }
+
+    static char const* word_end(char const* cursor) noexcept {
+        return find_word_end(cursor);
+    }
+}; // padded_search
+
+
+// Source is just terminated by '\0'
+struct terminated_search {
+    static char const* line_end(char const* cursor) noexcept {
+        return scalar::find_line_end(cursor);
+    }
+
+    template<char Q>
+    static char const* string_end(char const* cursor) noexcept {
+        return scalar::find_string_end<Q>(cursor);
+    }
+
+    static char const* word_end(char const* cursor) noexcept {
+        return scalar::find_word_end(cursor);
+    }
+}; // terminated_search
+
+
+template<typename Search> class basic_scaner {
+public:
+    basic_scaner() noexcept = default;
+    basic_scaner(basic_scaner const&) noexcept = default;
+    basic_scaner& operator = (basic_scaner const&) noexcept = default;
+    explicit basic_scaner(char* source): cursor_{source} { }
+    basic_scaner(char* source, int line_no):
+        cursor_{source}, line_no_{line_no} { }
+    int line_no() const noexcept { return line_no_; }
+    char* head() noexcept { return head_; }
+    char* tail() noexcept { return tail_; }
+    char* cursor() noexcept { return cursor_; }
+
+    std::string_view text() const noexcept {
+        return std::string_view{head_, std::size_t(tail_ - head_)};
+    }
+
+    bool scan_byte_order_mark() {
+        return detail::scan_byte_order_mark(cursor_);
     }
 
     token next() {
@@ -605,302 +2714,1692 @@ public:
             default:
                 goto skipped_whitespaces;
             }
-skipped_whitespaces:
-        switch(*cursor_) {
-        case '[':
-            ++cursor_;
-            return token::opened_square_brace;
-        case ']':
-            ++cursor_;
-            return token::closed_square_brace;
-        case '{':
-            ++cursor_;
-            return token::opened_figure_brace;
-        case '}':
-            ++cursor_;
-            return token::closed_figure_brace;
-        case '=':
-            ++cursor_;
-            return token::equal;
-        case ',':
-            ++cursor_;
-            return token::comma;
-        case '"':
-            return scan_string<'"'>();
-        case '\'':
-            return scan_string<'\''>();
-        case '\0':
-            return token::end;
+skipped_whitespaces:
+        switch(*cursor_) {
+        case '[':
+            ++cursor_;
+            return token::opened_square_brace;
+        case ']':
+            ++cursor_;
+            return token::closed_square_brace;
+        case '{':
+            ++cursor_;
+            return token::opened_figure_brace;
+        case '}':
+            ++cursor_;
+            return token::closed_figure_brace;
+        case '=':
+            ++cursor_;
+            return token::equal;
+        case ',':
+            ++cursor_;
+            return token::comma;
+        case '"':
+            return scan_string<'"'>();
+        case '\'':
+            return scan_string<'\''>();
+        case '\0':
+            return token::end;
+        default:
+            return scan_word();
+        }
+        // clang-format on
+    }
+
+    private:
+    char* cursor_{nullptr};
+    int line_no_{1};
+    char* head_;
+    char* tail_;
+
+    void skip_comment() {
+        cursor_ += Search::line_end(cursor_ + 1) - cursor_;
+        if(*cursor_ == '\n') {
+            ++cursor_;
+            ++line_no_;
+        }
+    }
+
+    template<char Q> token scan_string() {
+        head_ = ++cursor_;
+        cursor_ += Search::template string_end<Q>(cursor_) - cursor_;
+        if(*cursor_ != Q)
+            return token::unclosed_string;
+        tail_ = cursor_;
+        ++cursor_;
+        return token::text;
+    }
+
+    token scan_word() {
+        head_ = cursor_;
+        cursor_ += Search::word_end(cursor_) - cursor_;
+        tail_ = cursor_;
+        return token::text;
+    }
+}; // basic_scaner
+
+
+using scaner = basic_scaner<padded_search>;
+
+
+// Gives text of array item at cursor and moves cursor past comma or brace
+// after it
+inline std::string_view scan_item(char const*& cursor) noexcept {
+    scaner s{const_cast<char*>(cursor)};
+    s.next();
+    std::string_view const text = s.text();
+    s.next();
+    cursor = s.cursor();
+    return text;
+}
+
+
+// Finds where statements end in text that is only a part of the source so
+// far. Each byte is scanned once: token cut by the end of text is continued
+// from where its search stopped when more text arrives. Positions are
+// offsets, so text may move between scans.
+class statement_probe {
+public:
+    statement_probe() noexcept = default;
+    explicit statement_probe(std::size_t start) noexcept:
+        cursor_{start}, end_{start}
+    { }
+
+    // Text is terminated by '\0', gives offset past the last statement
+    // completed so far
+    std::size_t scan(char const* text) noexcept {
+        for(;;) {
+            token const tk = next(text);
+            if(tk == token::end)
+                return end_;
+            take(tk);
+        }
+    }
+
+    // Text before offset is dropped, the rest moved to its start
+    void shift(std::size_t offset) noexcept {
+        cursor_ -= offset;
+        end_ -= offset;
+    }
+
+private:
+    enum class lexeme : char {
+        none, word, comment, double_quoted, single_quoted
+    }; // lexeme
+
+    enum class expected : char {
+        statement, section_name, section_end, equal, value, nested
+    }; // expected
+
+    std::size_t cursor_{0};
+    std::size_t end_{0};
+    std::size_t depth_{0};
+    lexeme cut_{lexeme::none};
+    expected expected_{expected::statement};
+
+    // Errors end statement too, parser stops on them before its end
+    void take(token tk) noexcept {
+        switch(expected_) {
+        case expected::statement:
+            if(tk == token::opened_square_brace)
+                expected_ = expected::section_name;
+            else if(tk == token::text)
+                expected_ = expected::equal;
+            else
+                break;
+            return;
+        case expected::section_name:
+            if(tk != token::text)
+                break;
+            expected_ = expected::section_end;
+            return;
+        case expected::equal:
+            if(tk != token::equal)
+                break;
+            expected_ = expected::value;
+            return;
+        case expected::value:
+            if(tk != token::opened_square_brace
+               && tk != token::opened_figure_brace)
+                break;
+            depth_ = 1;
+            expected_ = expected::nested;
+            return;
+        case expected::nested:
+            if(tk == token::opened_square_brace
+               || tk == token::opened_figure_brace) {
+                ++depth_;
+                return;
+            }
+            if((tk == token::closed_square_brace
+                || tk == token::closed_figure_brace) && --depth_ == 0)
+                break;
+            if(tk == token::unclosed_string)
+                break;
+            return;
+        case expected::section_end:
+            break;
+        }
+        end_ = cursor_;
+        expected_ = expected::statement;
+    }
+
+    token next(char const* text) noexcept {
+        // clang-format off
+        for(;;) {
+            char const* cursor = text + cursor_;
+            if(cut_ == lexeme::none) {
+                for(;; ++cursor)
+                    switch(*cursor) {
+                    case ' ': case '\t': case '\r': case '\n':
+                        continue;
+                    default:
+                        goto skipped_whitespaces;
+                    }
+skipped_whitespaces:
+                cursor_ = std::size_t(cursor - text) + 1;
+                switch(*cursor) {
+                case '[': return token::opened_square_brace;
+                case ']': return token::closed_square_brace;
+                case '{': return token::opened_figure_brace;
+                case '}': return token::closed_figure_brace;
+                case '=': return token::equal;
+                case ',': return token::comma;
+                case '#': case ';':
+                    cut_ = lexeme::comment; break;
+                case '"':
+                    cut_ = lexeme::double_quoted; break;
+                case '\'':
+                    cut_ = lexeme::single_quoted; break;
+                case '\0':
+                    --cursor_; return token::end;
+                default:
+                    --cursor_; cut_ = lexeme::word; break;
+                }
+                cursor = text + cursor_;
+            }
+            switch(cut_) {
+            case lexeme::word:
+                cursor = find_word_end(cursor); break;
+            case lexeme::comment:
+                cursor = find_line_end(cursor); break;
+            case lexeme::double_quoted:
+                cursor = find_string_end<'"'>(cursor); break;
+            case lexeme::single_quoted:
+                cursor = find_string_end<'\''>(cursor); break;
+            case lexeme::none:
+                break;
+            }
+            cursor_ = std::size_t(cursor - text);
+            if(*cursor == '\0')
+                return token::end;
+            lexeme const finished = cut_;
+            cut_ = lexeme::none;
+            switch(finished) {
+            case lexeme::comment:
+                continue;
+            case lexeme::word:
+                return token::text;
+            default:
+                if(*cursor == '\n')
+                    return token::unclosed_string;
+                ++cursor_;
+                return token::text;
+            }
+        }
+        // clang-format on
+    }
+}; // statement_probe
+
+
+struct block_class {
+    std::uint64_t delimiters{0};
+    std::uint64_t spaces{0};
+    std::uint64_t zeros{0};
+}; // block_class
+
+
+#if CONFETTI_AVX2
+
+inline block_class classify(char const* block) noexcept {
+    block_class bc;
+    for(unsigned i = 0; i != 2; ++i) {
+        __m256i const chunk = simd::load256(block + i * 32);
+        __m256i const spaces = _mm256_or_si256(
+            _mm256_or_si256(simd::equal(chunk, ' '), simd::equal(chunk, '\t')),
+            simd::equal(chunk, '\r'));
+        unsigned const shift = i * 32;
+        bc.delimiters |= std::uint64_t(unsigned(_mm256_movemask_epi8(
+            simd::word_delimiters(chunk)))) << shift;
+        bc.spaces |= std::uint64_t(unsigned(_mm256_movemask_epi8(spaces)))
+                     << shift;
+        bc.zeros |= std::uint64_t(unsigned(_mm256_movemask_epi8(
+            simd::equal(chunk, '\0')))) << shift;
+    }
+    return bc;
+}
+
+#elif CONFETTI_SSE2
+
+inline block_class classify(char const* block) noexcept {
+    block_class bc;
+    for(unsigned i = 0; i != 4; ++i) {
+        __m128i const chunk = simd::load(block + i * 16);
+        __m128i const spaces = _mm_or_si128(
+            _mm_or_si128(simd::equal(chunk, ' '), simd::equal(chunk, '\t')),
+            simd::equal(chunk, '\r'));
+        unsigned const shift = i * 16;
+        bc.delimiters |= std::uint64_t(unsigned(_mm_movemask_epi8(
+            simd::word_delimiters(chunk)))) << shift;
+        bc.spaces |= std::uint64_t(unsigned(_mm_movemask_epi8(spaces)))
+                     << shift;
+        bc.zeros |= std::uint64_t(unsigned(_mm_movemask_epi8(
+            simd::equal(chunk, '\0')))) << shift;
+    }
+    return bc;
+}
+
+#else
+
+inline block_class classify(char const* block) noexcept {
+    // clang-format off
+    block_class bc;
+    for(unsigned i = 0; i != 64; ++i) {
+        std::uint64_t const bit = std::uint64_t{1} << i;
+        switch(block[i]) {
+        case '\0':
+            bc.zeros |= bit;
+            bc.delimiters |= bit;
+            continue;
+        case ' ': case '\t': case '\r':
+            bc.spaces |= bit;
+            bc.delimiters |= bit;
+            continue;
+        case '\n': case '[': case ']': case '{': case '}': case '=':
+        case ',': case '"': case '\'': case '#': case ';':
+            bc.delimiters |= bit;
+            continue;
+        default:
+            continue;
+        }
+    }
+    return bc;
+    // clang-format on
+}
+
+#endif
+
+
+// Stage one of indexed engine: bit per source byte that could start, end or
+// delimit a token. Whitespaces are marked only right after a word.
+class structural_index {
+public:
+    void build(char const* source) {
+        bits_.clear();
+        std::uint64_t previous_word = 0;
+        for(std::size_t offset = 0;; offset += 64) {
+            block_class const bc = classify(source + offset);
+            std::uint64_t const words = ~bc.delimiters;
+            std::uint64_t const follows_word = (words << 1) | previous_word;
+            previous_word = words >> 63;
+            bits_.push_back((bc.delimiters & ~bc.spaces)
+                            | (words & ~follows_word)
+                            | (bc.delimiters & follows_word));
+            if(bc.zeros != 0)
+                return;
+        }
+    }
+
+    // Never goes beyond terminating '\0'
+    std::size_t next(std::size_t position) const noexcept {
+        std::size_t index = position >> 6;
+        std::uint64_t bits = bits_[index] & (~std::uint64_t{0} << (position & 63));
+        while(bits == 0)
+            bits = bits_[++index];
+        return (index << 6) + trailing_zeros(bits);
+    }
+
+private:
+    std::vector<std::uint64_t> bits_;
+}; // structural_index
+
+
+// Stage two of indexed engine: produces the same tokens as scaner, but jumps
+// from one marked byte to another
+class indexed_scaner {
+public:
+    indexed_scaner() noexcept = default;
+    explicit indexed_scaner(char* source): source_{source} {
+        index_.build(source);
+    }
+    int line_no() const noexcept { return line_no_; }
+    char* head() noexcept { return head_; }
+    char* tail() noexcept { return tail_; }
+    char* cursor() noexcept { return source_ + cursor_; }
+
+    std::string_view text() const noexcept {
+        return std::string_view{head_, std::size_t(tail_ - head_)};
+    }
+
+    bool scan_byte_order_mark() {
+        char* cursor = source_ + cursor_;
+        bool const scanned = detail::scan_byte_order_mark(cursor);
+        cursor_ = std::size_t(cursor - source_);
+        return scanned;
+    }
+
+    token next() {
+        // clang-format off
+        for(;;) {
+            std::size_t const position = index_.next(cursor_);
+            cursor_ = position + 1;
+            switch(source_[position]) {
+            case ' ': case '\t': case '\r':
+                continue;
+            case '\n':
+                ++line_no_; continue;
+            case '#': case ';':
+                skip_comment(); continue;
+            case '[':
+                return token::opened_square_brace;
+            case ']':
+                return token::closed_square_brace;
+            case '{':
+                return token::opened_figure_brace;
+            case '}':
+                return token::closed_figure_brace;
+            case '=':
+                return token::equal;
+            case ',':
+                return token::comma;
+            case '"':
+                return scan_string<'"'>();
+            case '\'':
+                return scan_string<'\''>();
+            case '\0':
+                cursor_ = position;
+                return token::end;
+            default:
+                head_ = source_ + position;
+                cursor_ = index_.next(cursor_);
+                tail_ = source_ + cursor_;
+                return token::text;
+            }
+        }
+        // clang-format on
+    }
+
+private:
+    structural_index index_;
+    char* source_{nullptr};
+    std::size_t cursor_{0};
+    int line_no_{1};
+    char* head_;
+    char* tail_;
+
+    // Comments and strings are dense with word marks, so their ends are
+    // searched in source directly
+    void skip_comment() {
+        cursor_ = std::size_t(find_line_end(source_ + cursor_) - source_);
+        if(source_[cursor_] == '\n') {
+            ++cursor_;
+            ++line_no_;
+        }
+    }
+
+    template<char Q> token scan_string() {
+        head_ = source_ + cursor_;
+        char const* const end = find_string_end<Q>(head_);
+        cursor_ = std::size_t(end - source_);
+        if(*end != Q)
+            return token::unclosed_string;
+        tail_ = source_ + cursor_;
+        ++cursor_;
+        return token::text;
+    }
+}; // indexed_scaner
+
+
+
+// Body of section which starts right after its header
+struct lazy_range {
+    char* begin;
+    int line_no;
+    lazy_range* next;
+}; // lazy_range
+
+
+struct lazy_section {
+    lazy_context* context;
+    lazy_range* first;
+    lazy_range* last;
+    std::atomic<bool> ready{false};
+    value table;
+}; // lazy_section
+
+
+template<typename Scaner> class basic_parser {
+public:
+    basic_parser() = default;
+    basic_parser(basic_parser const&) = delete;
+    basic_parser& operator = (basic_parser const&) = delete;
+    basic_parser(basic_parser&&) = default;
+    basic_parser& operator = (basic_parser&&) = default;
+
+    basic_parser(detail::source_ptr source,
+                 mode m = mode::standard) noexcept:
+        result_{std::move(source)}, typed_{enabled(m, mode::typed)},
+        columns_{enabled(m, mode::columns)}
+    { }
+
+    // Allocates from borrowed arena, release() gives it back
+    basic_parser(arena_ptr memory, mode m) noexcept:
+        typed_{enabled(m, mode::typed)}, columns_{enabled(m, mode::columns)} {
+        result_.arena = std::move(memory);
+    }
+
+    result parse() {
+        if(!result_.source)
+            return std::move(result_);
+        scaner_ = Scaner{result_.source.get()};
+
+        if(!start())
+            return std::move(result_);
+
+        if(!scaner_.scan_byte_order_mark()) {
+            result_.error_code = make_error_code(error::invalid_byte_order_mark);
+            return std::move(result_);
+        }
+
+        while(parse_statement(scaner_.next()))
+            ;
+        return std::move(result_);
+    }
+
+    bool start() {
+        section_ = result_.config.insert("default",
+                                         value::make_table(*result_.arena));
+        if(section_ == nullptr)
+            return failed(error::not_enough_memory);
+        return true;
+    }
+
+    // Parses text which ends with its last statement, so none of them is
+    // cut. Line numbers continue from line_no.
+    bool parse_part(char* text, int& line_no) {
+        scaner_ = Scaner{text, line_no};
+        token tk;
+        while(parse_statement(tk = scaner_.next()))
+            ;
+        line_no = scaner_.line_no();
+        return tk == token::end;
+    }
+
+    // Parses all bodies of section, each up to the next section header
+    bool parse_section(lazy_range const* range, value& table) {
+        table = value::make_table(*result_.arena);
+        if(!table.is_table())
+            return failed(error::not_enough_memory);
+        section_ = &table;
+        for(; range != nullptr; range = range->next) {
+            scaner_ = Scaner{range->begin, range->line_no};
+            for(;;) {
+                token const tk = scaner_.next();
+                if(tk == token::end || tk == token::opened_square_brace)
+                    break;
+                if(!parse_statement(tk)) {
+                    table = value{};
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    // Parses statements starting before end, gives where the first one left
+    // starts. Names are not downcased but collected for lower_case_names,
+    // so nothing is written into source.
+    char* parse_slice(char* begin, char* end) {
+        defer_names_ = true;
+        scaner_ = Scaner{begin};
+        for(;;) {
+            token const tk = scaner_.next();
+            if(tk == token::end)
+                return scaner_.cursor();
+            char* const at = tk == token::text
+                ? scaner_.head()
+                : scaner_.cursor() - 1;
+            if(at >= end)
+                return at;
+            if(!parse_statement(tk))
+                return nullptr;
+        }
+    }
+
+    void lower_case_names() noexcept {
+        for(auto const& name: names_)
+            ascii::lower_case(name.first, name.second);
+    }
+
+    void fail(error e) { result_.error_code = make_error_code(e); }
+    arena& memory() noexcept { return *result_.arena; }
+    result& parsed() noexcept { return result_; }
+    result release() noexcept { return std::move(result_); }
+
+private:
+
+    result result_;
+    Scaner scaner_;
+    value* section_{nullptr};
+    std::vector<value> items_;
+    std::vector<std::uint64_t> numbers_;
+    std::vector<std::pair<char*, char*>> names_;
+    bool typed_{false};
+    bool columns_{false};
+    bool defer_names_{false};
+
+    bool failed(error e) {
+        result_.error_code = make_error_code(e);
+        result_.line_no = scaner_.line_no();
+        return false;
+    }
+
+    bool lower_case(char* head, char* tail) {
+        if(!defer_names_) {
+            ascii::lower_case(head, tail);
+            return true;
+        }
+        try {
+            names_.emplace_back(head, tail);
+        } catch(std::bad_alloc const&) {
+            return failed(error::not_enough_memory);
+        }
+        return true;
+    }
+
+    bool parse_statement(token tk) {
+        switch(tk) {
+        case token::opened_square_brace:
+            return parse_section_name();
+        case token::text:
+            return parse_property(*section_, scaner_.head(), scaner_.tail());
+        case token::end:
+            return false;
+        default:
+            return failed(error::expected_section_or_parameter);
+        }
+    }
+
+    bool parse_section_name() {
+        if(scaner_.next() != token::text)
+                return failed(error::invalid_section_name);
+        if(!lower_case(scaner_.head(), scaner_.tail()))
+            return false;
+        auto const name = scaner_.text();
+    if (scaner_.next() != token::closed_square_brace)
+                return failed(error::invalid_section_name);
+    if (equal_folded(name, "default")) {
+        section_ = result_.config.find("default");
+        } else {
+        if(result_.config.contains(name))
+                        return failed(error::duplicated_section);
+        section_ = result_.config.insert(name,
+                                         value::make_table(*result_.arena));
+        }
+        if(section_ == nullptr)
+            return failed(error::not_enough_memory);
+        return true;
+    }
+
+    bool parse_property(value& table, char* head, char* tail) {
+        if(!lower_case(head, tail))
+            return false;
+        auto const name = std::string_view{head, std::size_t(tail - head)};
+        if(section_->contains(name))
+            return failed(error::duplicated_parameter);
+        if(scaner_.next() != token::equal)
+            return failed(error::expected_equal_after_parameter_name);
+        value parsed;
+        if(!parse_property_value(scaner_.next(), parsed))
+            return false;
+        value* inserted = table.insert(name, std::move(parsed));
+        if(inserted == nullptr)
+            return failed(error::not_enough_memory);
+        return true;
+    }
+
+    // Items of arrays in columns mode are typed only when array is not column
+    bool parse_property_value(token tk, value& v, bool plain = false) {
+        switch(tk) {
+        case token::opened_square_brace:
+            return parse_array(v);
+        case token::opened_figure_brace:
+            return parse_table(v);
+        case token::text:
+            if(scaner_.text().size() > std::uint32_t(-1))
+                return failed(error::invalid_parameter_value);
+            if(!typed_ || plain) {
+                v = value::make(scaner_.text());
+                return true;
+            }
+            v = value::make_typed(*result_.arena, scaner_.text());
+            if(v.is_none())
+                return failed(error::not_enough_memory);
+            return true;
+        case token::unclosed_string:
+            return failed(error::unclosed_string);
         default:
-            return scan_word();
+            return failed(error::invalid_parameter_value);
         }
-        // clang-format on
     }
 
-    private:
-    char* cursor_{nullptr};
-    int line_no_{1};
-    char* head_;
-    char* tail_;
+    bool parse_array(value& array) {
+        std::size_t const first = items_.size();
+        char const* const text = scaner_.cursor();
+        token tk = scaner_.next();
+        if(tk != token::closed_square_brace)
+            for(;;) {
+                value item;
+                if(!parse_property_value(tk, item, columns_))
+                    return false;
+                try {
+                    items_.emplace_back(std::move(item));
+                } catch(std::bad_alloc const&) {
+                    return failed(error::not_enough_memory);
+                }
+                tk = scaner_.next();
+                if(tk == token::closed_square_brace)
+                    break;
+                if(tk != token::comma)
+                    return failed(error::expected_comma_or_closed_square_brace);
+                tk = scaner_.next();
+            }
+        if(columns_ && !parse_column(array, first, text))
+            return false;
+        if(!array.is_array())
+            array = value::make_array(*result_.arena, items_.data() + first,
+                                      items_.size() - first);
+        items_.erase(items_.begin() + first, items_.end());
+        if(!array.is_array())
+            return failed(error::not_enough_memory);
+        return true;
+    }
 
-    void skip_comment() {
-        ++cursor_;
-        for(;;)
-            switch(*cursor_) {
-            case '\n':
-                ++cursor_;
-                ++line_no_;
-                return;
-            case '\0':
-                return;
-            default:
-                ++cursor_;
+    // Array stays none when items are not all integers or all reals
+    bool parse_column(value& array, std::size_t first, char const* text) {
+        std::size_t const n = items_.size() - first;
+        try {
+            numbers_.resize(n);
+        } catch(std::bad_alloc const&) {
+            return failed(error::not_enough_memory);
+        }
+        array = value::make_column(*result_.arena, items_.data() + first, n,
+                                   numbers_.data(), text);
+        if(array.is_array() || !typed_)
+            return true;
+        for(std::size_t i = first; i != items_.size(); ++i) {
+            if(!items_[i].is_single())
+                continue;
+            items_[i] = value::make_typed(*result_.arena,
+                                          *(items_[i] | std::string_view{}));
+            if(items_[i].is_none())
+                return failed(error::not_enough_memory);
+        }
+        return true;
+    }
+
+    bool parse_table(value& table) {
+        table = value::make_table(*result_.arena);
+        if(!table.is_table())
+            return failed(error::not_enough_memory);
+        token tk = scaner_.next();
+        if(tk == token::closed_figure_brace)
+            return true;
+        for(;;) {
+            if(tk != token::text)
+                return failed(error::expected_parameter_in_table);
+            if(!parse_property(table, scaner_.head(), scaner_.tail()))
+                return false;
+            switch(scaner_.next()) {
+            case token::comma:
+                tk = scaner_.next();
                 continue;
+            case token::closed_figure_brace:
+                return true;
+            default:
+                return failed(error::expected_comma_or_closed_figure_brace);
             }
+        }
     }
 
-    template<char Q> token scan_string() {
-        head_ = ++cursor_;
+}; // basic_parser
+
+
+using parser = basic_parser<scaner>;
+using indexed_parser = basic_parser<indexed_scaner>;
+
+
+// Same grammar as basic_parser, but tokens go to handler instead of tree.
+// Neither allocates nor touches the source.
+template<typename Scaner, typename Handler> class walker {
+public:
+    walker(char* source, Handler& handler) noexcept:
+        scaner_{source}, handler_{handler}
+    { }
+
+    Scaner& scaner() noexcept { return scaner_; }
+
+    status walk() {
+        if(!scaner_.scan_byte_order_mark()) {
+            status_.error_code = make_error_code(error::invalid_byte_order_mark);
+            return status_;
+        }
+
         for(;;)
-            switch(*cursor_) {
-            case '\n':
-            case '\0':
-                return token::unclosed_string;
-            case Q:
-                tail_ = cursor_;
-                ++cursor_;
-                return token::text;
+            switch(scaner_.next()) {
+            case token::opened_square_brace:
+                if(!walk_section_name())
+                    return status_;
+                continue;
+            case token::text:
+                if(!walk_property())
+                    return status_;
+                continue;
+            case token::end:
+                return status_;
             default:
-                ++cursor_;
+                failed(error::expected_section_or_parameter);
+                return status_;
+            }
+    }
+
+private:
+
+    Scaner scaner_;
+    Handler& handler_;
+    status status_;
+
+    bool failed(error e) {
+        status_.error_code = make_error_code(e);
+        status_.line_no = scaner_.line_no();
+        return false;
+    }
+
+    bool stopped() {
+        status_.stopped = true;
+        status_.line_no = scaner_.line_no();
+        return false;
+    }
+
+    bool walk_section_name() {
+        if(scaner_.next() != token::text)
+            return failed(error::invalid_section_name);
+        auto const name = scaner_.text();
+        if(scaner_.next() != token::closed_square_brace)
+            return failed(error::invalid_section_name);
+        if(!handler_.on_section(name))
+            return stopped();
+        return true;
+    }
+
+    bool walk_property() {
+        if(!handler_.on_key(scaner_.text()))
+            return stopped();
+        if(scaner_.next() != token::equal)
+            return failed(error::expected_equal_after_parameter_name);
+        return walk_property_value(scaner_.next());
+    }
+
+    bool walk_property_value(token tk) {
+        switch(tk) {
+        case token::opened_square_brace:
+            return walk_array();
+        case token::opened_figure_brace:
+            return walk_table();
+        case token::text:
+            if(!handler_.on_scalar(scaner_.text()))
+                return stopped();
+            return true;
+        case token::unclosed_string:
+            return failed(error::unclosed_string);
+        default:
+            return failed(error::invalid_parameter_value);
+        }
+    }
+
+    bool walk_array() {
+        if(!handler_.on_array_begin())
+            return stopped();
+        token tk = scaner_.next();
+        if(tk != token::closed_square_brace)
+            for(;;) {
+                if(!walk_property_value(tk))
+                    return false;
+                tk = scaner_.next();
+                if(tk == token::closed_square_brace)
+                    break;
+                if(tk != token::comma)
+                    return failed(error::expected_comma_or_closed_square_brace);
+                tk = scaner_.next();
+            }
+        if(!handler_.on_array_end())
+            return stopped();
+        return true;
+    }
+
+    bool walk_table() {
+        if(!handler_.on_table_begin())
+            return stopped();
+        token tk = scaner_.next();
+        if(tk != token::closed_figure_brace)
+            for(;;) {
+                if(tk != token::text)
+                    return failed(error::expected_parameter_in_table);
+                if(!walk_property())
+                    return false;
+                tk = scaner_.next();
+                if(tk == token::closed_figure_brace)
+                    break;
+                if(tk != token::comma)
+                    return failed(error::expected_comma_or_closed_figure_brace);
+                tk = scaner_.next();
+            }
+        if(!handler_.on_table_end())
+            return stopped();
+        return true;
+    }
+
+}; // walker
+
+
+// Plain '\0'-terminated text has no padding for vectorized search
+template<typename Handler>
+using text_walker = walker<basic_scaner<terminated_search>, Handler>;
+template<typename Handler>
+using padded_walker = walker<scaner, Handler>;
+
+
+// First pass of lazy mode: validates syntax and records where bodies of
+// sections start, default section may have several of them
+class section_indexer: public handler {
+public:
+    explicit section_indexer(result& r) noexcept: result_{r} { }
+
+    bool start(padded_walker<section_indexer>& w) {
+        walker_ = &w;
+        default_ = add_section("default");
+        return default_ != nullptr
+            && add_range(*default_, w.scaner().cursor(), 1);
+    }
+
+    error failure() const noexcept { return failure_; }
+
+    bool on_section(std::string_view name) {
+        // Source is owned by result, names are downcased like parser does
+        char* const head = const_cast<char*>(name.data());
+        ascii::lower_case(head, head + name.size());
+        lazy_section* section = default_;
+        if(name != "default") {
+            if(result_.config.contains(name))
+                return failed(error::duplicated_section);
+            section = add_section(name);
+            if(section == nullptr)
+                return failed(error::not_enough_memory);
+        }
+        auto& scaner = walker_->scaner();
+        if(!add_range(*section, scaner.cursor(), scaner.line_no()))
+            return failed(error::not_enough_memory);
+        return true;
+    }
+
+private:
+    result& result_;
+    padded_walker<section_indexer>* walker_{nullptr};
+    lazy_section* default_{nullptr};
+    error failure_{error::ok};
+
+    bool failed(error e) noexcept {
+        failure_ = e;
+        return false;
+    }
+
+    lazy_section* add_section(std::string_view name) noexcept {
+        auto* section = result_.arena->create<lazy_section>();
+        if(section == nullptr)
+            return nullptr;
+        section->context = result_.lazy.get();
+        section->first = section->last = nullptr;
+        if(result_.config.insert(name, value::make_lazy(section)) == nullptr)
+            return nullptr;
+        return section;
+    }
+
+    bool add_range(lazy_section& section, char* begin, int line_no) noexcept {
+        auto* range = result_.arena->create<lazy_range>();
+        if(range == nullptr)
+            return false;
+        range->begin = begin;
+        range->line_no = line_no;
+        range->next = nullptr;
+        if(section.last == nullptr)
+            section.first = range;
+        else
+            section.last->next = range;
+        section.last = range;
+        return true;
+    }
+}; // section_indexer
+
+
+inline result parse_lazy(source_ptr source, mode m) {
+    result r{std::move(source)};
+    try {
+        r.lazy = std::make_unique<lazy_context>();
+        r.lazy->memory = std::make_unique<arena>();
+    } catch(std::bad_alloc const&) {
+        return result{error::not_enough_memory};
+    }
+    r.lazy->modes = m;
+    char* begin = r.source.get();
+    if(!scan_byte_order_mark(begin)) {
+        r.error_code = make_error_code(error::invalid_byte_order_mark);
+        return r;
+    }
+    section_indexer indexer{r};
+    padded_walker<section_indexer> w{begin, indexer};
+    if(!indexer.start(w))
+        return result{error::not_enough_memory};
+    status const s = w.walk();
+    if(s.stopped) {
+        r.error_code = make_error_code(indexer.failure());
+        r.line_no = s.line_no;
+    } else if(!s) {
+        r.error_code = s.error_code;
+        r.line_no = s.line_no;
+    }
+    return r;
+}
+
+
+// Section which fails to parse (duplicated parameter) becomes none, its
+// error is kept as deferred error of result
+inline value& materialize(lazy_section& section) noexcept {
+    if(section.ready.load(std::memory_order_acquire))
+        return section.table;
+    lazy_context& context = *section.context;
+    std::lock_guard<std::mutex> lock{context.mutex};
+    if(section.ready.load(std::memory_order_relaxed))
+        return section.table;
+    parser p{std::move(context.memory), context.modes};
+    bool const parsed = p.parse_section(section.first, section.table);
+    result released = p.release();
+    context.memory = std::move(released.arena);
+    if(!parsed && context.failure.load(std::memory_order_relaxed) == 0) {
+        context.failure_line_no.store(released.line_no,
+                                      std::memory_order_relaxed);
+        context.failure.store(released.error_code.value(),
+                              std::memory_order_release);
+    }
+    section.ready.store(true, std::memory_order_release);
+    return section.table;
+}
+
+
+// Runs f(0) in place, others on threads when they can be started
+template<typename F> void run_on_threads(std::size_t n, F const& f) {
+    std::vector<std::thread> threads;
+    std::size_t started = 1;
+    try {
+        threads.reserve(n - 1);
+        for(; started < n; ++started)
+            threads.emplace_back(f, started);
+    } catch(std::exception const&) {
+    }
+    f(0);
+    for(std::size_t i = started; i < n; ++i)
+        f(i);
+    for(auto& each: threads)
+        each.join();
+}
+
+
+// Splits source at lines starting with '[' and parses slices on threads.
+// Split is right if parser of previous slice stops exactly there; wrong
+// split, any error or duplicated name across slices make it parse source
+// sequentially again, so errors and line numbers are the same as usual.
+class parallel_parser {
+public:
+    static constexpr std::size_t min_slice_size = 1024 * 1024;
+
+    // Slices are chosen by size and number of cores when not given
+    static result parse(source_ptr source, mode m, std::size_t slices = 0) {
+        char* const text = source.get();
+        std::size_t const size = std::strlen(text);
+        if(slices == 0)
+            slices = std::min<std::size_t>(std::thread::hardware_concurrency(),
+                                           size / min_slice_size);
+        std::vector<char*> starts{text};
+        for(std::size_t i = 1; i < slices; ++i) {
+            std::size_t const from =
+                std::max(size / slices * i, std::size_t(starts.back() - text));
+            char* const found = find_split(text + from, text + size);
+            if(found == nullptr)
+                break;
+            starts.push_back(found);
+        }
+        if(starts.size() == 1 || !scan_byte_order_mark(starts.front()))
+            return sequential(std::move(source), m);
+
+        std::vector<parser> parsers;
+        std::vector<char*> stops(starts.size(), nullptr);
+        try {
+            parsers.reserve(starts.size());
+            parsers.emplace_back(std::move(source), m);
+            for(std::size_t i = 1; i != starts.size(); ++i)
+                parsers.emplace_back(source_ptr{}, m);
+        } catch(std::bad_alloc const&) {
+            if(!source)
+                source = parsers.front().release().source;
+            return sequential(std::move(source), m);
+        }
+        run_on_threads(starts.size(), [&](std::size_t i) {
+            char* const end = i + 1 == starts.size()
+                ? text + size
+                : starts[i + 1];
+            if(parsers[i].start())
+                stops[i] = parsers[i].parse_slice(starts[i], end);
+        });
+
+        // Tables keep pointer to arena of their parser, so merged result
+        // stays inside the first parser until the end and arenas of other
+        // slices are kept alive by its arena
+        result& merged = parsers.front().parsed();
+        bool split = true;
+        for(std::size_t i = 0; split && i != starts.size(); ++i)
+            split = stops[i] == (i + 1 == starts.size() ? text + size
+                                                         : starts[i + 1]);
+        for(std::size_t i = 1; split && i != parsers.size(); ++i) {
+            result slice = parsers[i].release();
+            split = merge(merged, slice);
+            merged.arena->adopt(std::move(slice.arena));
+        }
+        if(!split)
+            return sequential(std::move(merged.source), m);
+        run_on_threads(parsers.size(), [&](std::size_t i) {
+            parsers[i].lower_case_names();
+        });
+        return parsers.front().release();
+    }
+
+private:
+    // Line starting with '[' after line which does not obviously continue
+    static char* find_split(char* from, char* end) noexcept {
+        std::string_view const text{from, std::size_t(end - from)};
+        for(std::size_t found = text.find("\n["); found != text.npos;
+            found = text.find("\n[", found + 1)) {
+            std::size_t last = found;
+            while(last != 0 && (text[last - 1] == ' ' || text[last - 1] == '\t'
+                                || text[last - 1] == '\r'))
+                --last;
+            if(last == 0)
+                continue;
+            switch(text[last - 1]) {
+            case ',': case '[': case '{': case '=':
                 continue;
+            default:
+                return from + found + 1;
             }
+        }
+        return nullptr;
     }
 
-    token scan_word() {
-        // clang-format off
-        head_ = cursor_;
-        for(;;)
-            switch(*cursor_) {
-            case ' ': case '\t': case '\r': case '\n': case '\0':
-            case '[': case ']': case '{': case '}': case '=':
-            case ',': case '"': case '\'': case '#': case ';':
-                tail_ = cursor_;
-                return token::text;
-            default:
-                ++cursor_;
+    static result sequential(source_ptr source, mode m) {
+        parser p{std::move(source), m};
+        return p.parse();
+    }
+
+    static bool merge(result& merged, result& slice) noexcept {
+        value& defaults = *merged.config.find("default");
+        for(auto& section: *slice.config.table_) {
+            if(!equal_folded(section.key, "default")) {
+                if(merged.config.insert(section.key,
+                                        std::move(section.value)) == nullptr)
+                    return false;
                 continue;
             }
-        // clang-format on
+            for(auto& property: *section.value.table_)
+                if(defaults.insert(property.key,
+                                   std::move(property.value)) == nullptr)
+                    return false;
+        }
+        return true;
     }
-}; //scaner
+}; // parallel_parser
 
 
-class parser {
-public:
-    parser() = default;
-    parser(parser const&) = delete;
-    parser& operator = (parser const&) = delete;
-    parser(parser&&) = default;
-    parser& operator = (parser&&) = default;
-
-    parser(std::unique_ptr<char[]> source) noexcept:
-        result_{std::move(source)}
-    { }
+// Empty source is returned when file size is unknown (pipes, /proc files)
+inline source_ptr read_file(FILE* file) {
+    using namespace std;
+    source_ptr source;
+    fseek(file, 0, SEEK_END);
+    auto const file_size = ftell(file);
+    if (file_size == -1L)
+        return source;
+    if (file_size == 0) {
+        fseek(file, 0, SEEK_SET);
+        return source;
+    }
+    source.reset(new char[size_t(file_size) + source_padding]);
+    fseek(file, 0, SEEK_SET);
+    size_t const read_ok = fread(source.get(), 1, size_t(file_size), file);
+    if (read_ok != size_t(file_size)) {
+        source.reset();
+        return source;
+    }
+    memset(source.get() + file_size, 0, source_padding);
+    return source;
+}
 
-    result parse() {
-        if(!result_.source)
-            return std::move(result_);
-        scaner_ = scaner{result_.source.get()};
 
-        section_ = result_.config.insert("default",
-                                            value::make_table());
-        if(section_ == nullptr) {
-            result_.error_code = make_error_code(error::not_enough_memory);
-            return std::move(result_);
+inline source_ptr read_file(char const *file_name) {
+    using namespace std;
+    unique_ptr<FILE, int (*)(FILE *)>
+        file{fopen(file_name, "rb"), fclose};
+    if (!file)
+        return source_ptr{};
+    return read_file(file.get());
+}
+
+
+// Private (copy-on-write) mapping, so parser is free to downcase names in
+// place. The mapping is followed by zeroed anonymous pages when file tail
+// leaves no room for padding inside the last page.
+inline source_ptr map_file(char const* file_name) {
+#if CONFETTI_HAS_MMAP
+    int const fd = ::open(file_name, O_RDONLY | O_CLOEXEC);
+    if(fd == -1)
+        return source_ptr{};
+    struct stat info;
+    if(::fstat(fd, &info) == -1 || !S_ISREG(info.st_mode)) {
+        ::close(fd);
+        return read_file(file_name);
+    }
+    std::size_t const file_size = std::size_t(info.st_size);
+    std::size_t const page_size = std::size_t(::sysconf(_SC_PAGESIZE));
+    std::size_t const mapped_size =
+        (file_size + source_padding + page_size - 1) / page_size * page_size;
+    void* const area = ::mmap(nullptr, mapped_size, PROT_READ | PROT_WRITE,
+                              MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(area == MAP_FAILED) {
+        ::close(fd);
+        return source_ptr{};
+    }
+    if(file_size != 0) {
+        void* const mapped = ::mmap(area, file_size, PROT_READ | PROT_WRITE,
+                                    MAP_PRIVATE | MAP_FIXED, fd, 0);
+        if(mapped == MAP_FAILED) {
+            ::munmap(area, mapped_size);
+            ::close(fd);
+            return source_ptr{};
         }
+    }
+    ::close(fd);
+    return source_ptr{static_cast<char*>(area), source_deleter{mapped_size}};
+#else
+    return read_file(file_name);
+#endif
+}
 
-        if(!scaner_.scan_byte_order_mark()) {
-            result_.error_code = make_error_code(error::invalid_byte_order_mark);
-            return std::move(result_);
+
+inline result parse_source(source_ptr source, mode m) {
+    if(enabled(m, mode::lazy))
+        return parse_lazy(std::move(source), m);
+    if(enabled(m, mode::parallel))
+        return parallel_parser::parse(std::move(source), m);
+    if(enabled(m, mode::indexed)) {
+        indexed_parser p{std::move(source), m};
+        return p.parse();
+    }
+    parser p{std::move(source), m};
+    return p.parse();
+}
+
+} // detail
+
+
+// Parses source delivered in parts (pipes, sockets). Statements are parsed
+// once they are complete. Unparsed rest waits in a buffer which doubles when
+// it is short and is reused otherwise; where statements end is found by
+// statement_probe, which scans each byte once. Text of complete statements
+// is copied into segments carved from result arena and never copied again.
+// Segments double up to max_segment_size, so memory beyond source and its
+// tree is per segment its unused tail, shorter than the text which did not
+// fit, and the buffer, less than twice the longest statement with the part
+// fed after it; the buffer is freed by finish.
+// Engine modes are ignored, typed and columns ones are honored.
+class push_parser {
+public:
+    static constexpr std::size_t first_segment_size = 4096;
+    static constexpr std::size_t max_segment_size = 1024 * 1024;
+
+    explicit push_parser(mode m = mode::standard) noexcept:
+        parser_{detail::source_ptr{}, m}
+    {
+        failed_ = !parser_.start();
+    }
+
+    push_parser(push_parser const&) = delete;
+    push_parser& operator = (push_parser const&) = delete;
+
+    // Returns false when source is already known to be invalid
+    bool feed(char const* chunk, std::size_t size) {
+        if(failed_)
+            return false;
+        if(ended_)
+            return true;
+        if(void const* zero = std::memchr(chunk, '\0', size)) {
+            // Like parse_text, text ends at first zero
+            size = std::size_t(static_cast<char const*>(zero) - chunk);
+            ended_ = true;
         }
+        if(!append(chunk, size))
+            return false;
+        if(!started_ && filled_ - begin_ < 3)
+            return true;
+        return parse_available(false);
+    }
 
-        for(;;)
-            switch(scaner_.next()) {
-            case token::opened_square_brace:
-                if(!parse_section_name())
-                    return std::move(result_);
-                continue;
-            case token::text:
-                if(!parse_property(*section_, scaner_.head(), scaner_.tail()))
-                    return std::move(result_);
-                continue;
-            case token::end:
-                return std::move(result_);
-            default:
-                failed(error::expected_section_or_parameter);
-                return std::move(result_);
-            }
+    bool feed(std::string_view chunk) {
+        return feed(chunk.data(), chunk.size());
     }
 
-private:
+    result finish() {
+        if(!failed_ && !buffer_)
+            append("", 0);
+        if(!failed_)
+            parse_available(true);
+        buffer_.reset();
+        capacity_ = begin_ = filled_ = 0;
+        return parser_.release();
+    }
 
-    result result_;
-    scaner scaner_;
-    value* section_{nullptr};
+private:
+    detail::basic_parser<detail::scaner> parser_;
+    detail::statement_probe probe_;
+    std::unique_ptr<char[]> buffer_;
+    std::size_t capacity_{0};
+    std::size_t begin_{0};
+    std::size_t filled_{0};
+    char* segment_{nullptr};
+    std::size_t segment_capacity_{0};
+    std::size_t segment_used_{0};
+    int line_no_{1};
+    bool started_{false};
+    bool ended_{false};
+    bool failed_{false};
 
     bool failed(error e) {
-        result_.error_code = make_error_code(e);
-        result_.line_no = scaner_.line_no();
+        parser_.fail(e);
+        failed_ = true;
         return false;
     }
 
-    bool parse_section_name() {
-        if(scaner_.next() != token::text)
-                return failed(error::invalid_section_name);
-        ascii::lower_case(scaner_.head(), scaner_.tail());
-        auto const name = scaner_.text();
-    if (scaner_.next() != token::closed_square_brace)
-                return failed(error::invalid_section_name);
-    if (name == "default") {
-        section_ = result_.config.find("default");
-        } else {
-        if(result_.config.contains(name))
-                        return failed(error::duplicated_section);
-        section_ = result_.config.insert(name, value::make_table());
+    bool append(char const* chunk, std::size_t size) {
+        if(capacity_ - filled_ < size + detail::source_padding) {
+            std::size_t const pending = filled_ - begin_;
+            std::size_t const required =
+                pending + size + detail::source_padding;
+            if(required <= capacity_ / 2) {
+                // Text parsed since the last move is longer than pending
+                std::memmove(buffer_.get(), buffer_.get() + begin_, pending);
+            } else {
+                std::size_t const capacity =
+                    std::max(required * 2, first_segment_size);
+                std::unique_ptr<char[]> buffer{new(std::nothrow) char[capacity]};
+                if(!buffer)
+                    return failed(error::not_enough_memory);
+                if(pending != 0)
+                    std::memcpy(buffer.get(), buffer_.get() + begin_, pending);
+                buffer_ = std::move(buffer);
+                capacity_ = capacity;
+            }
+            probe_.shift(begin_);
+            begin_ = 0;
+            filled_ = pending;
         }
-        if(section_ == nullptr)
-            return failed(error::not_enough_memory);
+        if(size != 0)
+            std::memcpy(buffer_.get() + filled_, chunk, size);
+        filled_ += size;
+        std::memset(buffer_.get() + filled_, 0, detail::source_padding);
         return true;
     }
 
-    bool parse_property(value& table, char* head, char* tail) {
-        ascii::lower_case(head, tail);
-        auto const name = std::string_view{head, std::size_t(tail - head)};
-        if(section_->contains(name))
-            return failed(error::duplicated_parameter);
-        if(scaner_.next() != token::equal)
-            return failed(error::expected_equal_after_parameter_name);
-        value parsed;
-        if(!parse_property_value(scaner_.next(), parsed))
-            return false;
-        value* inserted = table.insert(name, std::move(parsed));
-        if(inserted == nullptr)
+    bool parse_available(bool last) {
+        if(!started_) {
+            started_ = true;
+            char* cursor = buffer_.get();
+            if(!detail::scan_byte_order_mark(cursor))
+                return failed(error::invalid_byte_order_mark);
+            begin_ = std::size_t(cursor - buffer_.get());
+            probe_ = detail::statement_probe{begin_};
+        }
+        std::size_t const end = last ? filled_ : probe_.scan(buffer_.get());
+        if(end == begin_)
+            return true;
+        char* const part = commit(end - begin_);
+        if(part == nullptr)
             return failed(error::not_enough_memory);
-        return true;
+        if(!parser_.parse_part(part, line_no_))
+            failed_ = true;
+        return !failed_;
     }
 
-    bool parse_property_value(token tk, value& v) {
-        switch(tk) {
-        case token::opened_square_brace:
-            return parse_array(v);
-        case token::opened_figure_brace:
-            return parse_table(v);
-        case token::text:
-            v = value::make(scaner_.text());
+    // Copies complete statements into segment, followed by padding which
+    // the next ones overwrite
+    char* commit(std::size_t size) {
+        if(segment_capacity_ - segment_used_ < size + detail::source_padding) {
+            std::size_t capacity = segment_capacity_ == 0
+                ? first_segment_size
+                : std::min(segment_capacity_ * 2, max_segment_size);
+            if(capacity < size + detail::source_padding)
+                capacity = size + detail::source_padding;
+            segment_ = static_cast<char*>(parser_.memory().allocate(capacity, 1));
+            if(segment_ == nullptr)
+                return nullptr;
+            segment_capacity_ = capacity;
+            segment_used_ = 0;
+        }
+        char* const part = segment_ + segment_used_;
+        std::memcpy(part, buffer_.get() + begin_, size);
+        std::memset(part + size, 0, detail::source_padding);
+        segment_used_ += size;
+        begin_ += size;
+        return part;
+    }
+}; // push_parser
+
+
+inline result parse_text(char const* text, mode m = mode::standard) {
+    size_t const n = (text == nullptr ? 0 : strlen(text));
+    detail::source_ptr buffer{new char[n + detail::source_padding]};
+    std::memcpy(buffer.get(), text, n);
+    std::memset(buffer.get() + n, 0, detail::source_padding);
+    return detail::parse_source(std::move(buffer), m);
+}
+
+
+// Reads stream up to its end in parts, so it need not be seekable
+inline result parse_stream(std::FILE* stream, mode m = mode::standard) {
+    push_parser parser{m};
+    char chunk[65536];
+    for(;;) {
+        std::size_t const n = std::fread(chunk, 1, sizeof(chunk), stream);
+        if(n != 0 && !parser.feed(chunk, n))
+            return parser.finish();
+        if(n != sizeof(chunk))
+            break;
+    }
+    if(std::ferror(stream))
+        return result{error::unable_to_read_file};
+    return parser.finish();
+}
+
+
+inline result parse(char const* filename, mode m = mode::standard) {
+    if(detail::enabled(m, mode::mapped))
+        if(detail::source_ptr source = detail::map_file(filename))
+            return detail::parse_source(std::move(source), m);
+    std::unique_ptr<std::FILE, int (*)(std::FILE*)>
+        file{std::fopen(filename, "rb"), std::fclose};
+    if(!file)
+        return result{error::unable_to_read_file};
+    if(detail::source_ptr source = detail::read_file(file.get()))
+        return detail::parse_source(std::move(source), m);
+    return parse_stream(file.get(), m);
+}
+
+
+inline result parse(std::string const& filename, mode m = mode::standard) {
+    return parse(filename.data(), m);
+}
+
+
+// Parses files on pool of workers, one per core by default. Results are
+// in order of names.
+template<typename Filenames>
+std::vector<result> parse_many(Filenames const& filenames,
+                               mode m = mode::standard, unsigned workers = 0) {
+    std::vector<result> parsed(filenames.size());
+    if(workers == 0)
+        workers = std::max(1u, std::thread::hardware_concurrency());
+    std::size_t const n = std::min<std::size_t>(workers, parsed.size());
+    std::atomic<std::size_t> next{0};
+    detail::run_on_threads(n, [&](std::size_t) {
+        for(std::size_t i = next++; i < parsed.size(); i = next++)
+            parsed[i] = parse(filenames[i], m);
+    });
+    return parsed;
+}
+
+
+inline result parse_mapped(char const* filename) {
+    return parse(filename, mode::mapped);
+}
+
+
+inline result parse_mapped(std::string const& filename) {
+    return parse(filename.data(), mode::mapped);
+}
+
+
+template<typename Handler>
+status scan_text(char const* text, Handler& handler) {
+    if(text == nullptr)
+        return status{};
+    // walker never writes through the pointer
+    detail::text_walker<Handler> w{const_cast<char*>(text), handler};
+    return w.walk();
+}
+
+
+template<typename Handler>
+status scan(char const* filename, Handler& handler) {
+    detail::source_ptr const source = detail::map_file(filename);
+    if(!source)
+        return status{error::unable_to_read_file};
+    detail::padded_walker<Handler> w{source.get(), handler};
+    return w.walk();
+}
+
+
+template<typename Handler>
+status scan(std::string const& filename, Handler& handler) {
+    return scan(filename.data(), handler);
+}
+
+
+enum struct unknown_keys {
+    skip, reject
+}; // unknown_keys
+
+
+namespace detail {
+
+// Converts scalars straight into members of bound structs while walking,
+// without building values. Frames are tables being filled: bound root,
+// section and nested inline tables
+class schema_handler: public handler {
+public:
+    schema_handler(field_target root, unknown_keys policy):
+        policy_{policy}
+    {
+        frames_.reserve(4);
+        frames_.push_back(root);
+    }
+
+    status finish(status s) const noexcept {
+        if(failure_ != error::ok) {
+            s.error_code = make_error_code(failure_);
+            s.stopped = false;
+        }
+        return s;
+    }
+
+    bool on_section(std::string_view name) {
+        frames_.resize(1);
+        skip_section_ = false;
+        if(equal_folded(name, "default"))
+            return true;
+        field_target section;
+        if(!find(frames_.front(), name, section) || section.find == nullptr) {
+            if(policy_ == unknown_keys::reject)
+                return failed(error::unexpected_section);
+            skip_section_ = true;
             return true;
-        case token::unclosed_string:
-            return failed(error::unclosed_string);
-        default:
-            return failed(error::invalid_parameter_value);
         }
+        frames_.push_back(section);
+        return true;
     }
 
-    bool parse_array(value& array) {
-        array = value::make_array();
-        token tk = scaner_.next();
-        if(tk == token::closed_square_brace)
+    bool on_key(std::string_view name) {
+        if(skip_depth_ != 0)
             return true;
-        for(;;) {
-            value item;
-            if(!parse_property_value(tk, item))
-                return false;
-            auto const emplaced = array.emplace_back(std::move(item));
-            if(!emplaced)
-                return failed(error::not_enough_memory);
-            switch(scaner_.next()) {
-            case token::comma:
-                tk = scaner_.next();
-                continue;
-            case token::closed_square_brace:
-                return true;
-            default:
-                return failed(error::expected_comma_or_closed_square_brace);
-            }
+        if(skip_section_ || !find(frames_.back(), name, pending_)) {
+            if(!skip_section_ && policy_ == unknown_keys::reject)
+                return failed(error::unexpected_parameter);
+            skip_value_ = true;
         }
+        return true;
     }
 
-    bool parse_table(value& table) {
-        table = value::make_table();
-        token tk = scaner_.next();
-        if(tk == token::closed_figure_brace)
+    bool on_scalar(std::string_view text) {
+        if(skip_depth_ != 0)
+            return true;
+        if(skip_value_) {
+            skip_value_ = false;
             return true;
-        for(;;) {
-            if(tk != token::text)
-                return failed(error::expected_parameter_in_table);
-            if(!parse_property(table, scaner_.head(), scaner_.tail()))
-                return false;
-            switch(scaner_.next()) {
-            case token::comma:
-                tk = scaner_.next();
-                continue;
-            case token::closed_figure_brace:
-                return true;
-            default:
-                return failed(error::expected_comma_or_closed_figure_brace);
-            }
         }
+        auto const convert = in_array_ ? pending_.item : pending_.scalar;
+        if(convert == nullptr || !convert(pending_.member, text))
+            return failed(error::invalid_parameter_value);
+        return true;
     }
 
-}; // parser
+    bool on_array_begin() {
+        if(skipped())
+            return true;
+        if(in_array_ || pending_.array == nullptr)
+            return failed(error::invalid_parameter_value);
+        pending_.array(pending_.member);
+        in_array_ = true;
+        return true;
+    }
 
+    bool on_array_end() {
+        if(skip_depth_ != 0)
+            --skip_depth_;
+        else
+            in_array_ = false;
+        return true;
+    }
 
-inline std::unique_ptr<char[]> read_file(char const *file_name) {
-    using namespace std;
-    unique_ptr<char[]> source;
-    unique_ptr<FILE, int (*)(FILE *)>
-        file{fopen(file_name, "rb"), fclose};
-    if (!file)
-        return source;
-    fseek(file.get(), 0, SEEK_END);
-    auto const file_size = ftell(file.get());
-    if (file_size == -1L)
-        return source;
-    source = make_unique<char[]>(file_size + 1);
-    fseek(file.get(), 0, SEEK_SET);
-    size_t const read_ok = fread(source.get(), 1, size_t(file_size),
-                                 file.get());
-    if (read_ok != size_t(file_size)) {
-        source.reset();
-        return source;
+    bool on_table_begin() {
+        if(skipped())
+            return true;
+        if(in_array_ || pending_.find == nullptr)
+            return failed(error::invalid_parameter_value);
+        frames_.push_back(pending_);
+        return true;
     }
-    source[file_size] = '\0';
-    return source;
-}
 
-} // detail
+    bool on_table_end() {
+        if(skip_depth_ != 0)
+            --skip_depth_;
+        else
+            frames_.pop_back();
+        return true;
+    }
+
+private:
+    std::vector<field_target> frames_;
+    field_target pending_;
+    unknown_keys policy_;
+    error failure_{error::ok};
+    unsigned skip_depth_{0};
+    bool skip_value_{false};
+    bool skip_section_{false};
+    bool in_array_{false};
+
+    static bool find(field_target const& frame, std::string_view key,
+                     field_target& found) noexcept {
+        return frame.find(frame.fields, frame.member, key, found);
+    }
 
+    // Arrays and tables of unknown keys are skipped with everything inside
+    bool skipped() noexcept {
+        if(skip_depth_ == 0 && !skip_value_)
+            return false;
+        skip_value_ = false;
+        ++skip_depth_;
+        return true;
+    }
 
-inline result parse_text(char const* text) {
-    size_t const n = (text == nullptr ? 0 : strlen(text));
-    std::unique_ptr<char[]> buffer = std::make_unique<char[]>(n + 1);
-    std::memcpy(buffer.get(), text, n);
-    buffer[n] = '\0';
-    detail::parser p{std::move(buffer)};
-    return p.parse();
+    bool failed(error e) noexcept {
+        failure_ = e;
+        return false;
+    }
+}; // schema_handler
+
+
+template<typename Struct, typename... Fields>
+field_target root_target(Struct& object,
+                         schema<Struct, Fields...> const& fields) noexcept {
+    field_target root;
+    root.member = &object;
+    root.fields = &fields;
+    root.find = &schema<Struct, Fields...>::find_target;
+    return root;
+}
+
+} // namespace detail
+
+
+// Keys of default section go to fields of schema, other sections to fields
+// bound by nested schemas. Error of conversion stops parsing at its line
+template<typename Struct, typename... Fields>
+status parse_text_into(char const* text, Struct& object,
+                       schema<Struct, Fields...> const& fields,
+                       unknown_keys policy = unknown_keys::skip) {
+    if(text == nullptr)
+        return status{};
+    detail::schema_handler handler{detail::root_target(object, fields), policy};
+    // walker never writes through the pointer
+    detail::text_walker<detail::schema_handler> w{const_cast<char*>(text),
+                                                  handler};
+    return handler.finish(w.walk());
 }
 
 
-inline result parse(char const* filename) {
-    std::unique_ptr<char[]> source = detail::read_file(filename);
+template<typename Struct, typename... Fields>
+status parse_into(char const* filename, Struct& object,
+                  schema<Struct, Fields...> const& fields,
+                  unknown_keys policy = unknown_keys::skip) {
+    static_assert(!schema<Struct, Fields...>::borrows_text,
+                  "Text of file is released after parse");
+    detail::source_ptr const source = detail::map_file(filename);
     if(!source)
-        return result{error::unable_to_read_file};
-    detail::parser p{std::move(source)};
-    return p.parse();
+        return status{error::unable_to_read_file};
+    detail::schema_handler handler{detail::root_target(object, fields), policy};
+    detail::padded_walker<detail::schema_handler> w{source.get(), handler};
+    return handler.finish(w.walk());
 }
 
 
-inline result parse(std::string const& filename) {
-    return parse(filename.data());
+template<typename Struct, typename... Fields>
+status parse_into(std::string const& filename, Struct& object,
+                  schema<Struct, Fields...> const& fields,
+                  unknown_keys policy = unknown_keys::skip) {
+    return parse_into(filename.data(), object, fields, policy);
 }
 
 } // confetti
@@ -0,0 +1,621 @@
+// This file is part of confetti library
+// Copyright 2020-2022 Andrei Ilin <ortfero@gmail.com>
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <confetti/confetti.hpp>
+
+
+namespace confetti {
+
+namespace detail {
+
+// Image is a header followed by 16 bytes nodes, table blocks and texts.
+// Nodes refer to their contents by offsets from the start of image, so it
+// is used as loaded, wherever mapped. Byte order is native, version check
+// rejects images of the other one
+inline constexpr char image_magic[8] = {'C', 'O', 'N', 'F', 'E', 'T', 'T', 'I'};
+inline constexpr std::uint32_t image_version = 1;
+
+
+struct image_header {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t root;
+    std::uint64_t size;
+    std::uint64_t source_hash;
+}; // image_header
+
+
+enum struct image_kind : std::uint8_t {
+    none, single, array, table
+}; // image_kind
+
+
+// Single: text at offset. Array: run of nodes at offset. Table: entries at
+// offset followed by open addressing index of mask + 1 slots, mask is zero
+// for tables scanned linearly
+struct image_node {
+    image_kind kind;
+    std::uint8_t reserved[3];
+    std::uint32_t size;
+    std::uint32_t offset;
+    std::uint32_t mask;
+}; // image_node
+
+
+struct image_entry {
+    std::uint32_t key;
+    std::uint32_t key_size;
+    std::uint32_t hash;
+    std::uint32_t reserved;
+    image_node value;
+}; // image_entry
+
+
+static_assert(sizeof(image_header) == 32);
+static_assert(sizeof(image_node) == 16);
+static_assert(sizeof(image_entry) == 32);
+
+
+// Four independent lanes keep multiplier busy on long sources
+inline std::uint64_t source_hash(std::string_view text) noexcept {
+    char const* p = text.data();
+    std::size_t n = text.size();
+    std::uint64_t lanes[4] = {0x2D358DCCAA6C78A5ull, 0x8BB84B93962EACC9ull,
+                              0x4B33A62ED433D4A3ull, 0x4D5A2DA51DE1AA47ull};
+    for(; n >= 32; p += 32, n -= 32)
+        for(unsigned i = 0; i != 4; ++i)
+            lanes[i] = hash_mix(lanes[i] ^ hash_load8(p + i * 8));
+    std::uint64_t h = text.size();
+    for(std::uint64_t lane: lanes)
+        h = hash_mix(h ^ lane);
+    return hash_bytes(std::string_view{p, n}, h);
+}
+
+} // namespace detail
+
+
+// Read only view of value inside image with interface of value
+class image_value {
+public:
+    using size_type = std::size_t;
+
+    image_value() noexcept = default;
+
+    image_value(char const* base, detail::image_node const* node) noexcept:
+        base_{base}, node_{node}
+    { }
+
+    bool is_none() const noexcept {
+        return kind() == detail::image_kind::none;
+    }
+
+    bool is_single() const noexcept {
+        return kind() == detail::image_kind::single;
+    }
+
+    bool is_array() const noexcept {
+        return kind() == detail::image_kind::array;
+    }
+
+    bool is_table() const noexcept {
+        return kind() == detail::image_kind::table;
+    }
+
+    size_type size() const noexcept {
+        if(is_array() || is_table())
+            return node_->size;
+        return 0;
+    }
+
+    bool empty() const noexcept {
+        return size() == 0;
+    }
+
+    image_value operator [] (size_type i) const noexcept {
+        if(!is_array() || i >= node_->size)
+            return image_value{};
+        return image_value{base_, nodes() + i};
+    }
+
+    image_value operator [] (std::string_view const& name) const noexcept {
+        return find(name, detail::hash(name));
+    }
+
+    template<std::size_t N>
+    image_value operator [] (char const (&name)[N]) const noexcept {
+        return (*this)[std::string_view{name, N - 1}];
+    }
+
+    image_value operator [] (key const& k) const noexcept {
+        return find(k.name(), k.hash());
+    }
+
+    bool contains(std::string_view const& name) const noexcept {
+        return !(*this)[name].is_none();
+    }
+
+    template<std::size_t N>
+    bool contains(char const (&name)[N]) const noexcept {
+        return contains(std::string_view{name, N - 1});
+    }
+
+    bool contains(key const& k) const noexcept {
+        return !(*this)[k].is_none();
+    }
+
+    // Scalars are converted the same way as by value
+    template<typename T>
+    auto operator | (T const& bydefault) const
+        -> decltype(value{} | bydefault) {
+        if(is_none())
+            return value{} | bydefault;
+        if(!is_single())
+            return std::nullopt;
+        return value::make(text()) | bydefault;
+    }
+
+    template<typename T>
+    std::optional<std::vector<T>> operator | (std::vector<T> bydefault) const {
+        if(is_none())
+            return {std::move(bydefault)};
+        if(!is_array())
+            return std::nullopt;
+        std::vector<T> result;
+        result.reserve(node_->size);
+        for(size_type i = 0; i != node_->size; ++i) {
+            std::optional<T> const item = image_value{base_, nodes() + i}
+                                          | T{};
+            if(!item)
+                return std::nullopt;
+            result.emplace_back(*item);
+        }
+        return {result};
+    }
+
+private:
+    char const* base_{nullptr};
+    detail::image_node const* node_{nullptr};
+
+    detail::image_kind kind() const noexcept {
+        return node_ == nullptr ? detail::image_kind::none : node_->kind;
+    }
+
+    std::string_view text() const noexcept {
+        return std::string_view{base_ + node_->offset, node_->size};
+    }
+
+    detail::image_node const* nodes() const noexcept {
+        return reinterpret_cast<detail::image_node const*>(
+            base_ + node_->offset);
+    }
+
+    detail::image_entry const* entries() const noexcept {
+        return reinterpret_cast<detail::image_entry const*>(
+            base_ + node_->offset);
+    }
+
+    bool matches(detail::image_entry const& e, std::string_view name,
+                 std::uint32_t h) const noexcept {
+        return e.hash == h && detail::equal_folded(
+            std::string_view{base_ + e.key, e.key_size}, name);
+    }
+
+    image_value find(std::string_view name, std::uint32_t h) const noexcept {
+        if(!is_table())
+            return image_value{};
+        detail::image_entry const* const found = entries();
+        std::uint32_t const n = node_->size;
+        std::uint32_t const mask = node_->mask;
+        if(mask == 0) {
+            for(std::uint32_t i = 0; i != n; ++i)
+                if(matches(found[i], name, h))
+                    return image_value{base_, &found[i].value};
+            return image_value{};
+        }
+        auto const* slots = reinterpret_cast<std::uint32_t const*>(found + n);
+        for(std::uint32_t slot = h & mask;; slot = (slot + 1) & mask) {
+            std::uint32_t const i = slots[slot];
+            if(i == 0)
+                return image_value{};
+            if(matches(found[i - 1], name, h))
+                return image_value{base_, &found[i - 1].value};
+        }
+    }
+}; // image_value
+
+
+struct image {
+
+    detail::source_ptr data;
+    std::error_code error_code;
+    unsigned line_no{0};
+    std::uint64_t source_hash{0};
+    image_value config;
+
+    image() = default;
+    image(image const&) = delete;
+    image& operator = (image const&) = delete;
+    image(image&&) = default;
+    image& operator = (image&&) = default;
+
+    explicit image(error e) noexcept:
+        error_code{int(e), confetti_category}
+    { }
+
+    explicit operator bool() const noexcept {
+        return !error_code;
+    }
+}; // image
+
+
+namespace detail {
+
+class image_writer {
+public:
+    // Empty when config does not fit into 32 bits offsets
+    static std::string write(value const& config, std::uint64_t source_hash) {
+        image_writer writer;
+        std::uint32_t const root = writer.reserve(sizeof(image_header)
+                                                  + sizeof(image_node))
+                                 + std::uint32_t(sizeof(image_header));
+        writer.put_node(root, config);
+        if(writer.too_big_)
+            return std::string{};
+        image_header header;
+        std::memcpy(header.magic, image_magic, sizeof(header.magic));
+        header.version = image_version;
+        header.root = root;
+        header.size = writer.out_.size();
+        header.source_hash = source_hash;
+        std::memcpy(writer.out_.data(), &header, sizeof(header));
+        return std::move(writer.out_);
+    }
+
+private:
+    std::string out_;
+    bool too_big_{false};
+
+    // Blocks are aligned by 8 bytes and zeroed
+    std::uint32_t reserve(std::size_t size) {
+        std::size_t const at = (out_.size() + 7) & ~std::size_t(7);
+        if(at + size > std::uint32_t(-1)) {
+            too_big_ = true;
+            return 0;
+        }
+        out_.resize(at + size, '\0');
+        return std::uint32_t(at);
+    }
+
+    std::uint32_t put_text(std::string_view text) {
+        std::uint32_t const at = reserve(text.size());
+        if(!too_big_)
+            std::memcpy(out_.data() + at, text.data(), text.size());
+        return at;
+    }
+
+    void put_node(std::uint32_t at, value const& v) {
+        value const& resolved = v.resolved();
+        image_node node{};
+        switch(resolved.kind_) {
+        case value::kind::single:
+        case value::kind::typed: {
+            std::string_view const text = resolved.single();
+            node.kind = image_kind::single;
+            node.size = std::uint32_t(text.size());
+            node.offset = put_text(text);
+            break;
+        }
+        case value::kind::array:
+            node.kind = image_kind::array;
+            node.size = resolved.size_;
+            node.offset = reserve(sizeof(image_node) * resolved.size_);
+            for(std::uint32_t i = 0; i != resolved.size_ && !too_big_; ++i)
+                put_node(node.offset + i * sizeof(image_node),
+                         resolved[i]);
+            break;
+        case value::kind::table:
+            node.kind = image_kind::table;
+            put_table(node, *resolved.table_);
+            break;
+        default:
+            break;
+        }
+        if(!too_big_)
+            std::memcpy(out_.data() + at, &node, sizeof(node));
+    }
+
+    void put_table(image_node& node, value::table const& table) {
+        std::uint32_t const n = std::uint32_t(table.size());
+        std::uint32_t slots = 0;
+        if(n > value::table::linear_limit)
+            for(slots = 1; slots < n * 2; slots *= 2) { }
+        node.size = n;
+        node.mask = slots == 0 ? 0 : slots - 1;
+        node.offset = reserve(sizeof(image_entry) * n
+                              + sizeof(std::uint32_t) * slots);
+        std::vector<std::uint32_t> index(slots, 0);
+        std::uint32_t i = 0;
+        for(auto const& each: table) {
+            if(too_big_)
+                return;
+            image_entry e{};
+            e.key = put_text(each.key);
+            e.key_size = std::uint32_t(each.key.size());
+            e.hash = table.hash_of(each);
+            std::uint32_t const at = node.offset + i * sizeof(image_entry);
+            put_node(at + offsetof(image_entry, value), each.value);
+            if(too_big_)
+                return;
+            e.value = reinterpret_cast<image_entry const*>(out_.data() + at)
+                          ->value;
+            std::memcpy(out_.data() + at, &e, sizeof(e));
+            if(slots != 0) {
+                std::uint32_t slot = e.hash & node.mask;
+                while(index[slot] != 0)
+                    slot = (slot + 1) & node.mask;
+                index[slot] = i + 1;
+            }
+            ++i;
+        }
+        if(slots != 0)
+            std::memcpy(out_.data() + node.offset + sizeof(image_entry) * n,
+                        index.data(), sizeof(std::uint32_t) * slots);
+    }
+}; // image_writer
+
+
+// Blocks of children are written after their node, which also rules out
+// cycles in damaged image
+inline bool valid_block(std::uint64_t at, std::uint64_t offset,
+                        std::uint64_t bytes, std::size_t size) noexcept {
+    return offset % alignof(image_node) == 0
+        && offset >= at + sizeof(image_node)
+        && offset + bytes <= size;
+}
+
+
+// Every node is checked once, so lookups stay inside image however it was
+// damaged on disk
+inline bool valid_image(char const* base, std::size_t size,
+                        std::uint32_t root) {
+    std::vector<std::uint64_t> pending{root};
+    while(!pending.empty()) {
+        std::uint64_t const at = pending.back();
+        pending.pop_back();
+        image_node node;
+        std::memcpy(&node, base + at, sizeof(node));
+        std::uint64_t const offset = node.offset;
+        std::uint64_t const n = node.size;
+        switch(node.kind) {
+        case image_kind::none:
+            break;
+        case image_kind::single:
+            if(offset + n > size)
+                return false;
+            break;
+        case image_kind::array:
+            if(!valid_block(at, offset, n * sizeof(image_node), size))
+                return false;
+            for(std::uint64_t i = 0; i != n; ++i)
+                pending.push_back(offset + i * sizeof(image_node));
+            break;
+        case image_kind::table: {
+            std::uint64_t const slots =
+                node.mask == 0 ? 0 : std::uint64_t(node.mask) + 1;
+            if((slots & (slots - 1)) != 0 || (slots != 0 && slots <= n)
+               || !valid_block(at, offset, n * sizeof(image_entry)
+                                           + slots * sizeof(std::uint32_t),
+                               size))
+                return false;
+            for(std::uint64_t i = 0; i != n; ++i) {
+                image_entry e;
+                std::memcpy(&e, base + offset + i * sizeof(image_entry),
+                            sizeof(e));
+                if(std::uint64_t(e.key) + e.key_size > size)
+                    return false;
+                pending.push_back(offset + i * sizeof(image_entry)
+                                  + offsetof(image_entry, value));
+            }
+            // Probing stops at empty slot, there has to be one
+            bool empty = false;
+            for(std::uint64_t i = 0; i != slots; ++i) {
+                std::uint32_t slot;
+                std::memcpy(&slot, base + offset + n * sizeof(image_entry)
+                                   + i * sizeof(slot), sizeof(slot));
+                if(slot > n)
+                    return false;
+                empty = empty || slot == 0;
+            }
+            if(slots != 0 && !empty)
+                return false;
+            break;
+        }
+        default:
+            return false;
+        }
+    }
+    return true;
+}
+
+
+inline image adopt_image(source_ptr data, std::size_t size) noexcept {
+    image loaded;
+    image_header header;
+    if(size < sizeof(header))
+        return image{error::invalid_image};
+    std::memcpy(&header, data.get(), sizeof(header));
+    if(std::memcmp(header.magic, image_magic, sizeof(header.magic)) != 0
+       || header.version != image_version || header.size != size
+       || header.root % alignof(image_node) != 0
+       || header.root + sizeof(image_node) > size)
+        return image{error::invalid_image};
+    try {
+        if(!valid_image(data.get(), size, header.root))
+            return image{error::invalid_image};
+    } catch(std::bad_alloc const&) {
+        return image{error::not_enough_memory};
+    }
+    loaded.source_hash = header.source_hash;
+    loaded.config = image_value{
+        data.get(),
+        reinterpret_cast<image_node const*>(data.get() + header.root)};
+    loaded.data = std::move(data);
+    return loaded;
+}
+
+
+inline image adopt_image(std::string const& bytes) noexcept {
+    source_ptr data{new(std::nothrow) char[bytes.size()]};
+    if(!data)
+        return image{error::not_enough_memory};
+    std::memcpy(data.get(), bytes.data(), bytes.size());
+    return adopt_image(std::move(data), bytes.size());
+}
+
+
+inline source_ptr map_image(char const* filename, std::size_t& size) {
+#if CONFETTI_HAS_MMAP
+    int const fd = ::open(filename, O_RDONLY | O_CLOEXEC);
+    if(fd == -1)
+        return source_ptr{};
+    struct stat info;
+    if(::fstat(fd, &info) == -1 || !S_ISREG(info.st_mode)
+       || info.st_size == 0) {
+        ::close(fd);
+        return source_ptr{};
+    }
+    size = std::size_t(info.st_size);
+    void* const mapped = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if(mapped == MAP_FAILED)
+        return source_ptr{};
+    return source_ptr{static_cast<char*>(mapped), source_deleter{size}};
+#else
+    source_ptr data = read_file(filename);
+    if(!data)
+        return data;
+    std::unique_ptr<std::FILE, int (*)(std::FILE*)>
+        file{std::fopen(filename, "rb"), &std::fclose};
+    if(!file || std::fseek(file.get(), 0, SEEK_END) != 0)
+        return source_ptr{};
+    size = std::size_t(std::ftell(file.get()));
+    return data;
+#endif
+}
+
+
+// Replaced by rename, so readers never see partially written image
+inline bool write_image(std::string const& bytes, char const* filename) {
+    std::string const temporary = std::string{filename} + ".tmp";
+    std::FILE* file = std::fopen(temporary.data(), "wb");
+    if(file == nullptr)
+        return false;
+    bool const written =
+        std::fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+    if(std::fclose(file) != 0 || !written
+       || std::rename(temporary.data(), filename) != 0) {
+        std::remove(temporary.data());
+        return false;
+    }
+    return true;
+}
+
+} // namespace detail
+
+
+// Relocatable image of parsed config, empty if parse failed
+inline std::string make_image(result const& parsed,
+                              std::uint64_t source_hash = 0) {
+    if(!parsed)
+        return std::string{};
+    return detail::image_writer::write(parsed.config, source_hash);
+}
+
+
+inline std::error_code save_image(result const& parsed, char const* filename,
+                                  std::uint64_t source_hash = 0) {
+    std::string const bytes = make_image(parsed, source_hash);
+    if(bytes.empty())
+        return parsed.error_code ? parsed.error_code
+                                 : make_error_code(error::not_enough_memory);
+    if(!detail::write_image(bytes, filename))
+        return make_error_code(error::unable_to_write_file);
+    return std::error_code{};
+}
+
+
+// Image is mapped and used in place
+inline image load_image(char const* filename) {
+    std::size_t size = 0;
+    detail::source_ptr data = detail::map_image(filename, size);
+    if(!data)
+        return image{error::unable_to_read_file};
+    return detail::adopt_image(std::move(data), size);
+}
+
+
+inline image load_image(std::string const& filename) {
+    return load_image(filename.data());
+}
+
+
+// Hash of text up to the first '\0', as stored by load_cached
+inline std::uint64_t source_hash(char const* text) noexcept {
+    if(text == nullptr)
+        return detail::source_hash(std::string_view{});
+    return detail::source_hash(std::string_view{text});
+}
+
+
+// Loads image when it was made from current content of source, otherwise
+// parses source and rebuilds image. Image is still returned when it can not
+// be saved
+inline image load_cached(char const* source_file, char const* image_file,
+                         mode m = mode::standard) {
+    detail::source_ptr source = detail::map_file(source_file);
+    if(!source)
+        return image{error::unable_to_read_file};
+    std::uint64_t const hash = source_hash(source.get());
+    image cached = load_image(image_file);
+    if(cached && cached.source_hash == hash)
+        return cached;
+
+    result const parsed = detail::parse_source(std::move(source), m);
+    if(!parsed) {
+        image failed;
+        failed.error_code = parsed.error_code;
+        failed.line_no = parsed.line_no;
+        return failed;
+    }
+    std::string const bytes = make_image(parsed, hash);
+    if(bytes.empty())
+        return image{error::not_enough_memory};
+    detail::write_image(bytes, image_file);
+    return detail::adopt_image(bytes);
+}
+
+
+inline image load_cached(std::string const& source_file,
+                         std::string const& image_file,
+                         mode m = mode::standard) {
+    return load_cached(source_file.data(), image_file.data(), m);
+}
+
+} // confetti
@@ -0,0 +1,387 @@
+// This file is part of confetti library
+// Copyright 2020-2022 Andrei Ilin <ortfero@gmail.com>
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+
+#include <atomic>
+#include <cerrno>
+#include <future>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <confetti/confetti.hpp>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <linux/stat.h>
+#include <sys/syscall.h>
+#define CONFETTI_HAS_URING 1
+#endif
+#endif
+
+#ifndef CONFETTI_HAS_URING
+#define CONFETTI_HAS_URING 0
+#endif
+
+
+namespace confetti {
+
+namespace detail {
+
+    inline char const* c_str(char const* name) noexcept { return name; }
+    inline char const* c_str(std::string const& name) noexcept {
+        return name.c_str();
+    }
+
+
+    // Parses files on workers when ring is not available
+    template<typename Filenames, typename Done>
+    void parse_each_on_threads(Filenames const& filenames, Done& done,
+                               mode m) {
+        std::size_t const n = filenames.size();
+        std::size_t const workers = std::min<std::size_t>(
+            std::max(1u, std::thread::hardware_concurrency()), n);
+        std::atomic<std::size_t> next{0};
+        std::mutex reporting;
+        run_on_threads(workers, [&](std::size_t) {
+            for(std::size_t i = next++; i < n; i = next++) {
+                result parsed = parse(c_str(filenames[i]), m);
+                std::lock_guard<std::mutex> lock{reporting};
+                done(i, std::move(parsed));
+            }
+        });
+    }
+
+
+#if CONFETTI_HAS_URING
+
+// Bare io_uring over raw system calls: single issuer, no SQ polling
+class uring {
+public:
+    uring() noexcept = default;
+    uring(uring const&) = delete;
+    uring& operator = (uring const&) = delete;
+
+    ~uring() {
+        if(sqes_ != nullptr)
+            ::munmap(sqes_, sqes_size_);
+        if(cq_ring_ != nullptr && cq_ring_ != sq_ring_)
+            ::munmap(cq_ring_, cq_ring_size_);
+        if(sq_ring_ != nullptr)
+            ::munmap(sq_ring_, sq_ring_size_);
+        if(fd_ != -1)
+            ::close(fd_);
+    }
+
+    // False when kernel or sandbox does not allow io_uring
+    bool open(unsigned entries) noexcept {
+        io_uring_params params{};
+        int const fd = int(::syscall(__NR_io_uring_setup, entries, &params));
+        if(fd < 0)
+            return false;
+        fd_ = fd;
+        sq_ring_size_ = params.sq_off.array
+                      + params.sq_entries * sizeof(unsigned);
+        cq_ring_size_ = params.cq_off.cqes
+                      + params.cq_entries * sizeof(io_uring_cqe);
+        bool const single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if(single)
+            sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_,
+                                                     cq_ring_size_);
+        sq_ring_ = map(sq_ring_size_, IORING_OFF_SQ_RING);
+        if(sq_ring_ == nullptr)
+            return false;
+        cq_ring_ = single ? sq_ring_ : map(cq_ring_size_, IORING_OFF_CQ_RING);
+        if(cq_ring_ == nullptr)
+            return false;
+        sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+        sqes_ = static_cast<io_uring_sqe*>(map(sqes_size_, IORING_OFF_SQES));
+        if(sqes_ == nullptr)
+            return false;
+
+        auto* const sq = static_cast<char*>(sq_ring_);
+        sq_tail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sq_mask_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sq_array_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        auto* const cq = static_cast<char*>(cq_ring_);
+        cq_head_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cq_tail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cq_mask_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+        entries_ = params.sq_entries;
+        return true;
+    }
+
+    unsigned entries() const noexcept { return entries_; }
+
+    void open_file(char const* path, std::uint64_t user_data) noexcept {
+        io_uring_sqe& sqe = next_sqe(IORING_OP_OPENAT, user_data);
+        sqe.fd = AT_FDCWD;
+        sqe.addr = reinterpret_cast<std::uintptr_t>(path);
+        sqe.open_flags = O_RDONLY | O_CLOEXEC;
+    }
+
+    void stat_file(char const* path, struct statx* info,
+                   std::uint64_t user_data) noexcept {
+        io_uring_sqe& sqe = next_sqe(IORING_OP_STATX, user_data);
+        sqe.fd = AT_FDCWD;
+        sqe.addr = reinterpret_cast<std::uintptr_t>(path);
+        sqe.len = STATX_TYPE | STATX_SIZE;
+        sqe.off = reinterpret_cast<std::uintptr_t>(info);
+    }
+
+    void read_file(int fd, char* buffer, std::size_t size,
+                   std::uint64_t offset, std::uint64_t user_data) noexcept {
+        io_uring_sqe& sqe = next_sqe(IORING_OP_READ, user_data);
+        sqe.fd = fd;
+        sqe.addr = reinterpret_cast<std::uintptr_t>(buffer);
+        sqe.len = unsigned(std::min<std::size_t>(size, 1u << 30));
+        sqe.off = offset;
+    }
+
+    // Submits queued requests and waits for at least one completion
+    bool submit_and_wait() noexcept {
+        for(;;) {
+            int const submitted = int(::syscall(__NR_io_uring_enter, fd_,
+                                                queued_, 1u,
+                                                IORING_ENTER_GETEVENTS,
+                                                nullptr, 0));
+            if(submitted >= 0) {
+                queued_ -= unsigned(submitted);
+                return true;
+            }
+            if(errno != EINTR)
+                return false;
+        }
+    }
+
+    template<typename F> void for_each_completion(F&& f) {
+        unsigned head = *cq_head_;
+        unsigned const tail =
+            __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+        for(; head != tail; ++head) {
+            io_uring_cqe const& cqe = cqes_[head & cq_mask_];
+            f(cqe.user_data, cqe.res);
+        }
+        __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+    }
+
+private:
+    int fd_{-1};
+    void* sq_ring_{nullptr};
+    void* cq_ring_{nullptr};
+    io_uring_sqe* sqes_{nullptr};
+    std::size_t sq_ring_size_{0};
+    std::size_t cq_ring_size_{0};
+    std::size_t sqes_size_{0};
+    unsigned* sq_tail_{nullptr};
+    unsigned* sq_array_{nullptr};
+    unsigned sq_mask_{0};
+    unsigned* cq_head_{nullptr};
+    unsigned* cq_tail_{nullptr};
+    unsigned cq_mask_{0};
+    io_uring_cqe* cqes_{nullptr};
+    unsigned entries_{0};
+    unsigned queued_{0};
+
+    void* map(std::size_t size, off_t offset) noexcept {
+        void* const mapped = ::mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                                    MAP_SHARED | MAP_POPULATE, fd_, offset);
+        return mapped == MAP_FAILED ? nullptr : mapped;
+    }
+
+    // Caller keeps number of requests in flight below entries()
+    io_uring_sqe& next_sqe(unsigned char opcode,
+                           std::uint64_t user_data) noexcept {
+        unsigned const tail = *sq_tail_;
+        unsigned const index = tail & sq_mask_;
+        io_uring_sqe& sqe = sqes_[index];
+        std::memset(&sqe, 0, sizeof(sqe));
+        sqe.opcode = opcode;
+        sqe.user_data = user_data;
+        sq_array_[index] = index;
+        __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+        ++queued_;
+        return sqe;
+    }
+}; // uring
+
+
+// Opens, stats and reads files in one ring, parses each as it lands.
+// File which can not be loaded this way (special files, errors, old
+// kernels) is parsed by the usual blocking path.
+template<typename Filenames, typename Done> class uring_loader {
+public:
+    uring_loader(Filenames const& filenames, Done& done, mode m):
+        filenames_{filenames}, done_{done}, mode_{m}, jobs_(filenames.size())
+    { }
+
+    // False when ring can not be set up
+    bool run() {
+        if(!ring_.open(256))
+            return false;
+        std::size_t const limit = ring_.entries() / 2;
+        std::size_t next = 0;
+        std::size_t in_flight = 0;
+        std::size_t finished = 0;
+        while(finished != jobs_.size()) {
+            for(; in_flight < limit && next != jobs_.size(); ++next, ++in_flight)
+                start(next);
+            if(!ring_.submit_and_wait()) {
+                finish_blocking();
+                return true;
+            }
+            ring_.for_each_completion([&](std::uint64_t user_data, int res) {
+                if(complete(std::size_t(user_data >> 2),
+                            unsigned(user_data & 3), res)) {
+                    --in_flight;
+                    ++finished;
+                }
+            });
+        }
+        return true;
+    }
+
+private:
+    enum step : unsigned { opening, stating, reading };
+
+    struct job {
+        int fd{-1};
+        unsigned pending{0};
+        bool failed{false};
+        struct statx info;
+        source_ptr buffer;
+        std::size_t size{0};
+        std::size_t loaded{0};
+        bool done{false};
+    }; // job
+
+    Filenames const& filenames_;
+    Done& done_;
+    mode mode_;
+    std::vector<job> jobs_;
+    uring ring_;
+
+    void start(std::size_t i) {
+        char const* const path = c_str(filenames_[i]);
+        jobs_[i].pending = 2;
+        ring_.open_file(path, (std::uint64_t(i) << 2) | opening);
+        ring_.stat_file(path, &jobs_[i].info, (std::uint64_t(i) << 2) | stating);
+    }
+
+    // True when file is done
+    bool complete(std::size_t i, unsigned s, int res) {
+        job& j = jobs_[i];
+        switch(s) {
+        case opening:
+            if(res >= 0)
+                j.fd = res;
+            else
+                j.failed = true;
+            return --j.pending == 0 && read(i);
+        case stating:
+            if(res < 0)
+                j.failed = true;
+            return --j.pending == 0 && read(i);
+        default:
+            if(res < 0) {
+                j.failed = true;
+                return finish(i);
+            }
+            j.loaded += std::size_t(res);
+            // File shrank while being read
+            if(res == 0)
+                j.size = j.loaded;
+            if(j.loaded == j.size)
+                return finish(i);
+            ring_.read_file(j.fd, j.buffer.get() + j.loaded,
+                            j.size - j.loaded, j.loaded,
+                            (std::uint64_t(i) << 2) | reading);
+            return false;
+        }
+    }
+
+    bool read(std::size_t i) {
+        job& j = jobs_[i];
+        // Special files do not know their size up front
+        if(j.failed || !S_ISREG(j.info.stx_mode) || j.info.stx_size == 0) {
+            j.failed = true;
+            return finish(i);
+        }
+        j.size = std::size_t(j.info.stx_size);
+        j.buffer.reset(new(std::nothrow) char[j.size + source_padding]);
+        if(!j.buffer) {
+            j.failed = true;
+            return finish(i);
+        }
+        ring_.read_file(j.fd, j.buffer.get(), j.size, 0,
+                        (std::uint64_t(i) << 2) | reading);
+        return false;
+    }
+
+    bool finish(std::size_t i) {
+        job& j = jobs_[i];
+        if(j.fd != -1)
+            ::close(j.fd);
+        j.fd = -1;
+        j.done = true;
+        if(j.failed) {
+            j.buffer.reset();
+            done_(i, parse(c_str(filenames_[i]), mode_));
+            return true;
+        }
+        std::memset(j.buffer.get() + j.size, 0, source_padding);
+        done_(i, parse_source(std::move(j.buffer), mode_));
+        return true;
+    }
+
+    // Ring broke down, files not parsed yet are loaded the blocking way
+    void finish_blocking() {
+        for(std::size_t i = 0; i != jobs_.size(); ++i)
+            if(!jobs_[i].done) {
+                jobs_[i].failed = true;
+                finish(i);
+            }
+    }
+}; // uring_loader
+
+#endif // CONFETTI_HAS_URING
+
+} // namespace detail
+
+
+// Loads files overlapping their I/O in io_uring when Linux allows it, or
+// on a pool of workers otherwise. done(index, result&&) is called as soon
+// as each file is parsed, never concurrently.
+template<typename Filenames, typename Done>
+void parse_each(Filenames const& filenames, Done&& done,
+                mode m = mode::standard) {
+#if CONFETTI_HAS_URING
+    detail::uring_loader<Filenames, Done> loader{filenames, done, m};
+    if(loader.run())
+        return;
+#endif
+    detail::parse_each_on_threads(filenames, done, m);
+}
+
+
+// Same as parse_each on its own thread, results are in order of names
+template<typename Filenames>
+std::future<std::vector<result>> parse_async(Filenames filenames,
+                                             mode m = mode::standard) {
+    return std::async(std::launch::async,
+                      [names = std::move(filenames), m] {
+        std::vector<result> parsed(names.size());
+        parse_each(names, [&](std::size_t i, result&& r) {
+            parsed[i] = std::move(r);
+        }, m);
+        return parsed;
+    });
+}
+
+} // confetti
@@ -0,0 +1,342 @@
+// This file is part of confetti library
+// Copyright 2020-2022 Andrei Ilin <ortfero@gmail.com>
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <confetti/confetti.hpp>
+
+#if defined(__linux__)
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#define CONFETTI_HAS_INOTIFY 1
+#else
+#include <condition_variable>
+#include <filesystem>
+#define CONFETTI_HAS_INOTIFY 0
+#endif
+
+
+namespace confetti {
+
+
+// Reparses file on its own thread whenever it changes and publishes result
+// as immutable snapshot. Readers pin snapshot by announcing current epoch in
+// one of reader slots, so they take no lock and touch no shared counter;
+// replaced result is freed once no slot announces epoch it was current in.
+// Readers beyond the number of slots announce epoch in a list under lock.
+// Failed reparse keeps previous snapshot, see last_error().
+class watcher {
+public:
+    static constexpr std::size_t reader_slots = 64;
+
+    class snapshot {
+    public:
+        snapshot() noexcept = default;
+        snapshot(snapshot const&) = delete;
+        snapshot& operator = (snapshot const&) = delete;
+
+        snapshot(snapshot&& other) noexcept:
+            slot_{std::exchange(other.slot_, nullptr)},
+            overflow_{std::exchange(other.overflow_, nullptr)},
+            epoch_{other.epoch_},
+            result_{std::exchange(other.result_, nullptr)}
+        { }
+
+        snapshot& operator = (snapshot&& other) noexcept {
+            if(this == &other)
+                return *this;
+            release();
+            slot_ = std::exchange(other.slot_, nullptr);
+            overflow_ = std::exchange(other.overflow_, nullptr);
+            epoch_ = other.epoch_;
+            result_ = std::exchange(other.result_, nullptr);
+            return *this;
+        }
+
+        ~snapshot() { release(); }
+
+        result const& operator * () const noexcept { return *result_; }
+        result const* operator -> () const noexcept { return result_; }
+        value const& config() const noexcept { return result_->config; }
+
+    private:
+        friend class watcher;
+
+        std::atomic<std::uint64_t>* slot_{nullptr};
+        watcher const* overflow_{nullptr};
+        std::uint64_t epoch_{0};
+        result const* result_{nullptr};
+
+        snapshot(std::atomic<std::uint64_t>* slot, result const* r) noexcept:
+            slot_{slot}, result_{r}
+        { }
+
+        snapshot(watcher const* overflow, std::uint64_t epoch,
+                 result const* r) noexcept:
+            overflow_{overflow}, epoch_{epoch}, result_{r}
+        { }
+
+        void release() noexcept {
+            if(slot_ != nullptr)
+                slot_->store(0, std::memory_order_release);
+            if(overflow_ != nullptr)
+                overflow_->unpin(epoch_);
+            slot_ = nullptr;
+            overflow_ = nullptr;
+            result_ = nullptr;
+        }
+    }; // snapshot
+
+    // File is parsed once here, snapshot of failed parse is published too
+    explicit watcher(std::string filename, mode m = mode::standard):
+        filename_{std::move(filename)}, mode_{m},
+        current_{new result{parse(filename_, m)}}
+    {
+        try {
+            start();
+        } catch(...) {
+            delete current_.load();
+            throw;
+        }
+    }
+
+    watcher(watcher const&) = delete;
+    watcher& operator = (watcher const&) = delete;
+
+    // Snapshots must be released before watcher is destroyed
+    ~watcher() {
+        stop();
+        delete current_.load();
+        for(auto const& each: retired_)
+            delete each.first;
+    }
+
+    // Lock free while fewer than reader_slots snapshots are held, may throw
+    // std::bad_alloc only beyond that
+    snapshot current() const {
+        std::size_t const first =
+            std::hash<std::thread::id>{}(std::this_thread::get_id());
+        for(std::size_t i = 0; i != reader_slots; ++i) {
+            auto& slot = slots_[(first + i) % reader_slots].epoch;
+            std::uint64_t idle = 0;
+            // Epoch is read before slot is taken: reclaimer either sees
+            // the slot, or the pointer read below is already the new one
+            std::uint64_t const epoch = epoch_.load();
+            if(slot.compare_exchange_strong(idle, epoch))
+                return snapshot{&slot, current_.load()};
+        }
+        std::lock_guard<std::mutex> lock{overflow_mutex_};
+        std::uint64_t const epoch = epoch_.load();
+        overflow_.push_back(epoch);
+        return snapshot{this, epoch, current_.load()};
+    }
+
+    // Result of the last reparse
+    std::error_code last_error() const noexcept {
+        int const code = last_error_.load(std::memory_order_relaxed);
+        return code == 0 ? std::error_code{} : make_error_code(error(code));
+    }
+
+    // Number of published reparses
+    std::uint64_t reloads() const noexcept {
+        return reloads_.load(std::memory_order_acquire);
+    }
+
+private:
+    struct alignas(64) reader_slot {
+        std::atomic<std::uint64_t> epoch{0};
+    }; // reader_slot
+
+    std::string filename_;
+    mode mode_;
+    std::atomic<result const*> current_;
+    std::atomic<std::uint64_t> epoch_{1};
+    mutable reader_slot slots_[reader_slots];
+    mutable std::mutex overflow_mutex_;
+    mutable std::vector<std::uint64_t> overflow_;
+    std::vector<std::pair<result const*, std::uint64_t>> retired_;
+    std::atomic<int> last_error_{0};
+    std::atomic<std::uint64_t> reloads_{0};
+    std::atomic<bool> stopping_{false};
+    std::thread thread_;
+#if CONFETTI_HAS_INOTIFY
+    int inotify_{-1};
+    int wakeup_{-1};
+#else
+    std::mutex mutex_;
+    std::condition_variable stopped_;
+#endif
+
+    void reload() {
+        auto parsed = std::make_unique<result>(parse(filename_, mode_));
+        last_error_.store(parsed->error_code.value(),
+                          std::memory_order_relaxed);
+        if(!*parsed)
+            return;
+        result const* replaced = current_.exchange(parsed.release());
+        retired_.emplace_back(replaced, epoch_.fetch_add(1));
+        reloads_.fetch_add(1, std::memory_order_release);
+        reclaim();
+    }
+
+    void unpin(std::uint64_t epoch) const noexcept {
+        std::lock_guard<std::mutex> lock{overflow_mutex_};
+        auto const found = std::find(overflow_.begin(), overflow_.end(), epoch);
+        *found = overflow_.back();
+        overflow_.pop_back();
+    }
+
+    // Result retired in epoch E may be pinned only by readers announcing E
+    // or earlier
+    void reclaim() {
+        std::uint64_t oldest = epoch_.load();
+        for(auto const& slot: slots_) {
+            std::uint64_t const pinned = slot.epoch.load();
+            if(pinned != 0 && pinned < oldest)
+                oldest = pinned;
+        }
+        {
+            std::lock_guard<std::mutex> lock{overflow_mutex_};
+            for(std::uint64_t const pinned: overflow_)
+                oldest = std::min(oldest, pinned);
+        }
+        auto kept = retired_.begin();
+        for(auto& each: retired_) {
+            if(each.second < oldest)
+                delete each.first;
+            else
+                *kept++ = each;
+        }
+        retired_.erase(kept, retired_.end());
+    }
+
+#if CONFETTI_HAS_INOTIFY
+
+    // Directory is watched, editors often replace file by renaming.
+    // Creation is not watched, new file is still empty or partly written
+    void start() {
+        inotify_ = ::inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+        wakeup_ = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        if(inotify_ == -1 || wakeup_ == -1) {
+            close_descriptors();
+            throw std::system_error{errno, std::system_category()};
+        }
+        std::size_t const slash = filename_.rfind('/');
+        std::string const directory = slash == std::string::npos
+            ? std::string{"."}
+            : filename_.substr(0, slash + 1);
+        if(::inotify_add_watch(inotify_, directory.data(),
+                               IN_CLOSE_WRITE | IN_MOVED_TO) == -1) {
+            int const failure = errno;
+            close_descriptors();
+            throw std::system_error{failure, std::system_category()};
+        }
+        thread_ = std::thread{[this] { run(); }};
+    }
+
+    void stop() noexcept {
+        stopping_.store(true);
+        std::uint64_t const one = 1;
+        if(::write(wakeup_, &one, sizeof(one)) == -1) {
+            // eventfd counter can not overflow with single write
+        }
+        if(thread_.joinable())
+            thread_.join();
+        close_descriptors();
+    }
+
+    void close_descriptors() noexcept {
+        if(inotify_ != -1)
+            ::close(inotify_);
+        if(wakeup_ != -1)
+            ::close(wakeup_);
+        inotify_ = wakeup_ = -1;
+    }
+
+    void run() {
+        std::size_t const slash = filename_.rfind('/');
+        std::string_view const name = slash == std::string::npos
+            ? std::string_view{filename_}
+            : std::string_view{filename_}.substr(slash + 1);
+        alignas(inotify_event) char events[4096];
+        while(!stopping_.load()) {
+            pollfd polled[2] = {{inotify_, POLLIN, 0}, {wakeup_, POLLIN, 0}};
+            // Retired results are checked for readers every 100 ms
+            int const timeout = retired_.empty() ? -1 : 100;
+            if(::poll(polled, 2, timeout) == -1 && errno != EINTR)
+                return;
+            bool changed = false;
+            for(;;) {
+                auto const n = ::read(inotify_, events, sizeof(events));
+                if(n <= 0)
+                    break;
+                for(char* p = events; p < events + n;) {
+                    auto const* event = reinterpret_cast<inotify_event*>(p);
+                    if(event->len != 0 && name == event->name)
+                        changed = true;
+                    p += sizeof(inotify_event) + event->len;
+                }
+            }
+            if(changed)
+                reload();
+            else
+                reclaim();
+        }
+    }
+
+#else
+
+    // Modification time is polled once per second
+    void start() {
+        thread_ = std::thread{[this] { run(); }};
+    }
+
+    void stop() noexcept {
+        {
+            std::lock_guard<std::mutex> lock{mutex_};
+            stopping_.store(true);
+        }
+        stopped_.notify_all();
+        if(thread_.joinable())
+            thread_.join();
+    }
+
+    void run() {
+        namespace fs = std::filesystem;
+        std::error_code failure;
+        auto modified = fs::last_write_time(filename_, failure);
+        std::unique_lock<std::mutex> lock{mutex_};
+        while(!stopping_.load()) {
+            stopped_.wait_for(lock, std::chrono::seconds{1});
+            auto const now = fs::last_write_time(filename_, failure);
+            if(!failure && now != modified) {
+                modified = now;
+                reload();
+            } else {
+                reclaim();
+            }
+        }
+    }
+
+#endif
+}; // watcher
+
+} // confetti
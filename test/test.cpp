@@ -1,9 +1,62 @@
 #include <confetti/confetti.hpp>
+#include <confetti/image.hpp>
+#include <confetti/uring.hpp>
+#include <confetti/watcher.hpp>
+
+#include <chrono>
+#include <clocale>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+#include <malloc.h>
+#define HAS_MALLINFO2 1
+#endif
 
 #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
 #include "doctest.h"
 
 
+static void write_file(char const* name, std::string const& content) {
+    std::FILE* file = std::fopen(name, "wb");
+    REQUIRE(file != nullptr);
+    std::fwrite(content.data(), 1, content.size(), file);
+    std::fclose(file);
+}
+
+
+static std::string read_file(char const* name) {
+    std::string content;
+    std::FILE* file = std::fopen(name, "rb");
+    REQUIRE(file != nullptr);
+    char buffer[4096];
+    for(;;) {
+        auto const n = std::fread(buffer, 1, sizeof(buffer), file);
+        if(n == 0)
+            break;
+        content.append(buffer, n);
+    }
+    std::fclose(file);
+    return content;
+}
+
+
+// Zero where heap statistics are not available
+static std::size_t heap_in_use() {
+#if HAS_MALLINFO2
+    struct mallinfo2 const info = ::mallinfo2();
+    return info.uordblks + info.hblkhd;
+#else
+    return 0;
+#endif
+}
+
+
 
 TEST_CASE("parse empty string") {
     confetti::result r = confetti::parse_text(nullptr);
@@ -164,6 +217,278 @@ TEST_CASE("parse long integer") {
 }
 
 
+TEST_CASE("integers with separators and limits") {
+    using confetti::detail::parse_signed;
+    using confetti::detail::parse_unsigned;
+    REQUIRE_EQ(*parse_signed<int>("1_000_000"), 1000000);
+    REQUIRE_EQ(*parse_signed<int>("-2_147_483_648"), -2147483647 - 1);
+    REQUIRE_EQ(*parse_signed<long long>("-9223372036854775808"),
+               -9223372036854775807ll - 1);
+    REQUIRE_EQ(*parse_unsigned<unsigned long long>("18446744073709551615"),
+               18446744073709551615ull);
+    REQUIRE_EQ(*parse_unsigned<unsigned long long>("000000000000000000000042"),
+               42);
+    REQUIRE_EQ(*parse_unsigned<unsigned>("0xDEAD_beef"), 0xDEADBEEFu);
+    REQUIRE_EQ(*parse_unsigned<unsigned>("+12345678"), 12345678u);
+    REQUIRE_EQ(*parse_signed<short>("-32768"), -32768);
+    for(char const* wrong: {"", "+", "-", "_1", "1_", "1__0", "1_x", "12a",
+                            "0x", "0x_1", "1.0", " 1", "2147483648",
+                            "-2147483649", "99999999999999999999"})
+        REQUIRE_FALSE(parse_signed<int>(wrong).has_value());
+    for(char const* wrong: {"-1", "18446744073709551616",
+                            "0x10000000000000000", "0x1_", "0xg"})
+        REQUIRE_FALSE(parse_unsigned<unsigned long long>(wrong).has_value());
+    REQUIRE_FALSE(parse_unsigned<unsigned char>("256").has_value());
+
+    std::uint64_t state = 0x2545F4914F6CDD1Dull;
+    for(int i = 0; i != 100000; ++i) {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        std::uint64_t const bits = state >> (state % 64);
+        std::string const text = std::to_string(bits);
+        REQUIRE_EQ(*parse_unsigned<unsigned long long>(text), bits);
+        auto const narrow = static_cast<long long>(bits) >> (state % 3 * 16);
+        REQUIRE_EQ(*parse_signed<long long>(std::to_string(narrow)), narrow);
+        std::string const padded = "0000" + text;
+        REQUIRE_EQ(*parse_unsigned<unsigned long long>(padded), bits);
+        std::optional<unsigned> const small = parse_unsigned<unsigned>(text);
+        REQUIRE_EQ(small.has_value(), bits <= 0xFFFFFFFFull);
+    }
+}
+
+
+TEST_CASE("parse integer arrays") {
+    std::string text = "k1 = [";
+    for(int i = 0; i != 1000; ++i)
+        text += std::to_string(i * 1000003 - 500000000) + ", ";
+    text += "1_000, +7]\nk2 = [1, 2, x]\nk3 = [1, [2]]\nk4 = [0x10, 1]\n";
+    for(auto const m: {confetti::mode::standard, confetti::mode::typed,
+                       confetti::mode::columns}) {
+        confetti::result r = confetti::parse_text(text.data(), m);
+        REQUIRE(r);
+        auto const& section = r.config["default"];
+        std::vector<int> const k1 = *(section["k1"] | std::vector<int>{});
+        REQUIRE_EQ(k1.size(), 1002);
+        for(int i = 0; i != 1000; ++i)
+            REQUIRE_EQ(k1[i], i * 1000003 - 500000000);
+        REQUIRE_EQ(k1[1000], 1000);
+        REQUIRE_EQ(k1[1001], 7);
+        REQUIRE_FALSE((section["k1"] | std::vector<unsigned>{}).has_value());
+        REQUIRE_FALSE((section["k2"] | std::vector<int>{}).has_value());
+        REQUIRE_FALSE((section["k3"] | std::vector<long long>{}).has_value());
+        REQUIRE_EQ(*(section["k4"] | std::vector<unsigned>{}),
+                   std::vector<unsigned>{16, 1});
+    }
+}
+
+
+TEST_CASE("numeric arrays are stored as columns") {
+    char const* text =
+        "ints = [1, -2, 3_000, 9223372036854775807]\n"
+        "reals = [1.5, 2, -1e3]\n"
+        "mixed = [1, x]\n"
+        "nested = [1, [2]]\n"
+        "empty = []\n"
+        "hex = [0x10, 1]\n"
+        "huge = [18446744073709551615, 1]\n"
+        "hexes = [0xFFFFFFFFFFFFFFFF, 0x10]\n"
+        "inexact = [0.5, 9007199254740993]\n"
+        "[section]\n"
+        "narrow = [1, 100000]\n";
+    confetti::result const standard = confetti::parse_text(text);
+    for(auto const m: {confetti::mode::columns,
+                       confetti::mode::columns | confetti::mode::typed,
+                       confetti::mode::columns | confetti::mode::lazy}) {
+        confetti::result r = confetti::parse_text(text, m);
+        REQUIRE(r);
+        auto const& section = r.config["default"];
+        auto const ints = section["ints"].as_span<std::int64_t>();
+        REQUIRE_EQ(std::vector<std::int64_t>(ints.begin(), ints.end()),
+                   std::vector<std::int64_t>{1, -2, 3000,
+                                             9223372036854775807ll});
+        REQUIRE(section["ints"].as_span<double>().empty());
+        REQUIRE_EQ(*(section["ints"][2] | 0), 3000);
+        REQUIRE_EQ(*(section["ints"] | std::vector<long long>{}),
+                   std::vector<long long>{1, -2, 3000, 9223372036854775807ll});
+        REQUIRE_FALSE((section["ints"] | std::vector<int>{}).has_value());
+        auto const reals = section["reals"].as_span<double>();
+        REQUIRE_EQ(std::vector<double>(reals.begin(), reals.end()),
+                   std::vector<double>{1.5, 2., -1000.});
+        REQUIRE_EQ(*(section["reals"] | std::vector<double>{}),
+                   std::vector<double>{1.5, 2., -1000.});
+        REQUIRE_EQ(*(section["reals"][0] | std::string{}), "1.5");
+        REQUIRE(section["mixed"].as_span<std::int64_t>().empty());
+        REQUIRE(section["mixed"].as_span<double>().empty());
+        REQUIRE(section["nested"].as_span<std::int64_t>().empty());
+        REQUIRE(section["empty"].as_span<std::int64_t>().empty());
+        REQUIRE_EQ(*(r.config["section"]["narrow"] | std::vector<unsigned>{}),
+                   std::vector<unsigned>{1, 100000});
+        REQUIRE_FALSE((section["ints"] | std::vector<unsigned>{}).has_value());
+
+        // Numbers not exact in column stay items
+        for(char const* name: {"hex", "huge", "hexes", "inexact"}) {
+            REQUIRE(section[name].as_span<std::int64_t>().empty());
+            REQUIRE(section[name].as_span<double>().empty());
+        }
+        REQUIRE_EQ(*(section["hex"] | std::vector<unsigned long long>{}),
+                   std::vector<unsigned long long>{16, 1});
+        REQUIRE_EQ(*(section["huge"] | std::vector<unsigned long long>{}),
+                   std::vector<unsigned long long>{18446744073709551615ull, 1});
+        REQUIRE_EQ(*(section["hexes"] | std::vector<unsigned long long>{}),
+                   std::vector<unsigned long long>{18446744073709551615ull,
+                                                   16});
+        REQUIRE_EQ(*(section["huge"][0] | std::string{}),
+                   "18446744073709551615");
+
+        // Items read one by one keep text of source
+        std::string texts;
+        for(auto const [key, item]: section["reals"])
+            texts += *(item | std::string{}) + ";";
+        REQUIRE_EQ(texts, "1.5;2;-1e3;");
+        REQUIRE_EQ(*(section["ints"][2] | std::string{}), "3_000");
+        REQUIRE_EQ(&section["ints"][1], &section["ints"][1]);
+        REQUIRE(section["ints"][4].is_none());
+        REQUIRE_EQ(*(section["mixed"][0] | 0), 1);
+        REQUIRE_EQ(*(section["mixed"][0] | 0.), 1.);
+        REQUIRE(confetti::diff(r, confetti::parse_text(text, m)).empty());
+        REQUIRE_EQ(confetti::fingerprint(confetti::parse_text(text, m)),
+                   confetti::fingerprint(standard));
+        REQUIRE(confetti::diff(r, standard).empty());
+    }
+    REQUIRE(standard);
+    REQUIRE(standard.config["default"]["ints"].as_span<std::int64_t>().empty());
+
+    // Nodes of items are made once for all threads
+    std::string big = "data = [";
+    for(int i = 0; i != 10000; ++i)
+        big += std::to_string(i * 0.5) + ", ";
+    big += "0]\n";
+    for(int round = 0; round != 8; ++round) {
+        confetti::result const column =
+            confetti::parse_text(big.data(), confetti::mode::columns);
+        auto const& data = column.config["default"]["data"];
+        REQUIRE_EQ(data.as_span<double>().size(), 10001);
+        std::vector<confetti::value const*> seen(4);
+        std::vector<std::thread> readers;
+        for(std::size_t t = 0; t != seen.size(); ++t)
+            readers.emplace_back([&, t] { seen[t] = &data[5000]; });
+        for(auto& each: readers)
+            each.join();
+        for(auto const* each: seen)
+            REQUIRE_EQ(each, &data[5000]);
+        REQUIRE_EQ(*(data[5000] | 0.), 2500.);
+    }
+}
+
+
+
+TEST_CASE("read arrays into caller buffers") {
+    char const* text =
+        "ints = [1, -2, 3]\n"
+        "names = [alpha, 'beta gamma']\n"
+        "flags = [true, false]\n"
+        "mixed = [1, x]\n"
+        "empty = []\n";
+    for(auto const m: {confetti::mode::standard, confetti::mode::typed,
+                       confetti::mode::columns}) {
+        confetti::result r = confetti::parse_text(text, m);
+        REQUIRE(r);
+        auto const& section = r.config["default"];
+
+        std::vector<int> ints;
+        ints.reserve(16);
+        int const* const buffer = ints.data();
+        REQUIRE(section["ints"].read_into(ints));
+        REQUIRE_EQ(ints, std::vector<int>{1, -2, 3});
+        REQUIRE_EQ(ints.data(), buffer);
+        REQUIRE_FALSE(section["mixed"].read_into(ints));
+        REQUIRE(ints.empty());
+        REQUIRE_FALSE(section["missing"].read_into(ints));
+        REQUIRE(section["empty"].read_into(ints));
+        REQUIRE(ints.empty());
+
+        std::vector<std::string> names{std::string(64, 'x'), "y", "z"};
+        char const* const first = names[0].data();
+        REQUIRE(section["names"].read_into(names));
+        REQUIRE_EQ(names, std::vector<std::string>{"alpha", "beta gamma"});
+        REQUIRE_EQ(names[0].data(), first);
+
+        std::vector<bool> flags;
+        REQUIRE(section["flags"].read_into(flags));
+        REQUIRE_EQ(flags, std::vector<bool>{true, false});
+
+        double reals[4] = {};
+        REQUIRE(section["ints"].copy_to(confetti::span<double>{reals, 4}));
+        REQUIRE_EQ(reals[0], 1.);
+        REQUIRE_EQ(reals[2], 3.);
+        REQUIRE_EQ(reals[3], 0.);
+        REQUIRE_FALSE(section["ints"].copy_to(confetti::span<double>{reals, 2}));
+        REQUIRE_FALSE(section["mixed"].copy_to(confetti::span<double>{reals, 4}));
+
+        long long sum = 0;
+        for(std::optional<long long> each: section["ints"].as_range<long long>())
+            sum += *each;
+        REQUIRE_EQ(sum, 2);
+        std::vector<std::optional<int>> converted;
+        for(auto each: section["mixed"].as_range<int>())
+            converted.push_back(each);
+        REQUIRE_EQ(converted.size(), 2);
+        REQUIRE_EQ(*converted[0], 1);
+        REQUIRE_FALSE(converted[1].has_value());
+        REQUIRE(section["missing"].as_range<int>().empty());
+        auto const names_range = section["names"].as_range<std::string_view>();
+        REQUIRE_EQ(names_range.size(), 2);
+        REQUIRE_EQ(**std::next(names_range.begin()), "beta gamma");
+    }
+}
+
+
+
+TEST_CASE("iterate tables and arrays in file order") {
+    char const* text =
+        "zeta = 1\n"
+        "alpha = [x, y]\n"
+        "[upstream-b]\n"
+        "host = b\n"
+        "[upstream-a]\n"
+        "host = a\n"
+        "limits = {rps = 10, burst = 20}\n";
+    for(auto const m: {confetti::mode::standard, confetti::mode::lazy,
+                       confetti::mode::indexed}) {
+        confetti::result r = confetti::parse_text(text, m);
+        REQUIRE(r);
+        std::vector<std::string> sections;
+        for(auto const [name, section]: r.config) {
+            REQUIRE(section.is_table());
+            sections.emplace_back(name);
+        }
+        REQUIRE_EQ(sections, std::vector<std::string>{"default", "upstream-b",
+                                                      "upstream-a"});
+        auto const& main = r.config["default"];
+        auto it = main.begin();
+        REQUIRE_EQ((*it).first, "zeta");
+        REQUIRE_EQ(*((*it).second | 0), 1);
+        ++it;
+        REQUIRE_EQ((*it).first, "alpha");
+        std::string items;
+        for(auto const [key, item]: (*it).second) {
+            REQUIRE(key.empty());
+            items += *(item | std::string{});
+        }
+        REQUIRE_EQ(items, "xy");
+        REQUIRE(++it == main.end());
+        std::vector<std::string> limits;
+        for(auto const [key, limit]: r.config["upstream-a"]["limits"])
+            limits.push_back(std::string{key} + "=" + *(limit | std::string{}));
+        REQUIRE_EQ(limits, std::vector<std::string>{"rps=10", "burst=20"});
+        REQUIRE(main["zeta"].begin() == main["zeta"].end());
+        REQUIRE(main["missing"].begin() == main["missing"].end());
+    }
+}
+
+
+
 TEST_CASE("parse double") {
     confetti::result r = confetti::parse_text("k1 = -3.14E+2\n");
     REQUIRE(r);
@@ -175,6 +500,98 @@ TEST_CASE("parse double") {
 
 
 
+TEST_CASE("parse float") {
+    confetti::result r = confetti::parse_text(
+        "k1 = 0.1\nk2 = [1.5, -2e3, 16777217]\nk3 = x\n");
+    REQUIRE(r);
+    auto const& section = r.config["default"];
+    REQUIRE_EQ(*(section["k1"] | 0.f), 0.1f);
+    REQUIRE_EQ(*(section["k2"] | std::vector<float>{}),
+               std::vector<float>{1.5f, -2000.f, 16777216.f});
+    REQUIRE_FALSE((section["k3"] | 0.f).has_value());
+    REQUIRE_EQ(*(section["k4"] | 2.5f), 2.5f);
+}
+
+
+
+TEST_CASE("real numbers round trip") {
+    using confetti::detail::parse_real;
+    auto same = [](auto lhs, auto rhs) {
+        return std::memcmp(&lhs, &rhs, sizeof(lhs)) == 0;
+    };
+    std::uint64_t state = 0x9E3779B97F4A7C15ull;
+    auto random = [&] {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return state;
+    };
+    char text[64];
+
+    for(int i = 0; i != 200000; ++i) {
+        std::uint64_t const bits = random();
+        double number;
+        std::memcpy(&number, &bits, sizeof(number));
+        if(number != number || number - number != 0.)
+            continue;
+        std::snprintf(text, sizeof(text), "%.17g", number);
+        REQUIRE(same(*parse_real(text), number));
+        std::snprintf(text, sizeof(text), "%.*g", int(bits % 16) + 1, number);
+        REQUIRE(same(*parse_real(text), std::strtod(text, nullptr)));
+    }
+
+    // Decimals taken by fast path and the ones next to its limits
+    for(int i = 0; i != 200000; ++i) {
+        std::uint64_t const mantissa = random() >> (random() % 64);
+        int const exponent = int(random() % 61) - 30;
+        std::snprintf(text, sizeof(text), "%llue%d",
+                      static_cast<unsigned long long>(mantissa), exponent);
+        REQUIRE(same(*parse_real(text), std::strtod(text, nullptr)));
+        REQUIRE(same(*parse_real<float>(text), std::strtof(text, nullptr)));
+        std::snprintf(text, sizeof(text), "-0.%llu",
+                      static_cast<unsigned long long>(mantissa));
+        REQUIRE(same(*parse_real(text), std::strtod(text, nullptr)));
+    }
+
+    // Every 4093rd float
+    for(std::uint64_t bits = 0; bits < (std::uint64_t(1) << 32); bits += 4093) {
+        std::uint32_t const narrow = std::uint32_t(bits);
+        float number;
+        std::memcpy(&number, &narrow, sizeof(number));
+        if(number != number || number - number != 0.f)
+            continue;
+        std::snprintf(text, sizeof(text), "%.9g", double(number));
+        REQUIRE(same(*parse_real<float>(text), number));
+    }
+
+    for(char const* each: {"1.", ".5", "-0", "+2.5e-3", "1E22", "9007199254740993",
+                           "0x1p-2", "-0x10", "inf", "-nan", "1e400", "1e-400",
+                           "4.9e-324", "00000000000000000000001.5"})
+        REQUIRE(same(*parse_real(each), std::strtod(each, nullptr)));
+    for(char const* each: {"", ".", "-", "1e", "1e+", "e5", "1.2.3", "0x",
+                           "1,5", "12a", " 1", "0x-5", "-0x-5"})
+        REQUIRE_FALSE(parse_real(each).has_value());
+}
+
+
+
+TEST_CASE("real numbers do not depend on locale") {
+    char const* previous = std::setlocale(LC_NUMERIC, nullptr);
+    std::string const restored = previous == nullptr ? "C" : previous;
+    for(char const* name: {"de_DE.UTF-8", "de_DE.utf8", "fr_FR.UTF-8",
+                           "ru_RU.UTF-8"}) {
+        if(std::setlocale(LC_NUMERIC, name) == nullptr)
+            continue;
+        REQUIRE_EQ(*confetti::detail::parse_real("3.14"), 3.14);
+        REQUIRE_EQ(*confetti::detail::parse_real(
+                       "3.141592653589793238462643383279"), 3.141592653589793);
+        REQUIRE_FALSE(confetti::detail::parse_real("3,14").has_value());
+    }
+    std::setlocale(LC_NUMERIC, restored.data());
+}
+
+
+
 TEST_CASE("parse string") {
     confetti::result r = confetti::parse_text(
         "k1 = \"\"\n"
@@ -281,3 +698,1201 @@ TEST_CASE("parse inline array of tables") {
     REQUIRE(v2);
     REQUIRE_EQ(*v2, "foo");
 }
+
+
+
+TEST_CASE("parse mapped file") {
+    char const* name = "confetti-test-mapped.ini";
+    std::string const text = "[Section]\nKey = Value\n";
+    write_file(name, text);
+
+    confetti::result r = confetti::parse_mapped(name);
+    REQUIRE(r);
+    auto const value = r.config["section"]["key"] | "";
+    REQUIRE(value);
+    REQUIRE_EQ(*value, "Value");
+    REQUIRE_EQ(read_file(name), text);
+
+    r = confetti::parse(name, confetti::mode::mapped);
+    REQUIRE(r);
+    REQUIRE(r.config.contains("section"));
+
+    std::remove(name);
+    r = confetti::parse_mapped(name);
+    REQUIRE_FALSE(r);
+    REQUIRE_EQ(r.error_code.value(),
+               int(confetti::error::unable_to_read_file));
+}
+
+
+
+TEST_CASE("parse mapped file filling whole pages") {
+    char const* name = "confetti-test-pages.ini";
+    std::string text = "key = ";
+    text.append(8192 - text.size(), 'x');
+    write_file(name, text);
+
+    confetti::result r = confetti::parse_mapped(name);
+    std::remove(name);
+    REQUIRE(r);
+    auto const value = r.config["default"]["key"] | std::string_view{};
+    REQUIRE(value);
+    REQUIRE_EQ(value->size(), 8192 - 6);
+
+    write_file(name, "");
+    r = confetti::parse_mapped(name);
+    std::remove(name);
+    REQUIRE(r);
+    REQUIRE(r.config.contains("default"));
+}
+
+
+
+TEST_CASE("vectorized search matches scalar one") {
+    char const alphabet[] = "ab \t\r\n[]{}=,\"'#;\x01\x7f\xe2\x80";
+    std::string text;
+    unsigned seed = 12345;
+    for(int i = 0; i != 4096; ++i) {
+        seed = seed * 1103515245u + 12345u;
+        text.push_back(alphabet[(seed >> 16) % (sizeof(alphabet) - 1)]);
+        if(i % 97 == 0)
+            text.append(40, 'x');
+    }
+    text.append(confetti::detail::source_padding, '\0');
+
+    using namespace confetti::detail;
+    for(std::size_t i = 0; i != text.size() - source_padding; ++i) {
+        char const* cursor = text.data() + i;
+        REQUIRE_EQ(find_line_end(cursor), scalar::find_line_end(cursor));
+        REQUIRE_EQ(find_string_end<'"'>(cursor),
+                   scalar::find_string_end<'"'>(cursor));
+        REQUIRE_EQ(find_string_end<'\''>(cursor),
+                   scalar::find_string_end<'\''>(cursor));
+        REQUIRE_EQ(find_word_end(cursor), scalar::find_word_end(cursor));
+    }
+}
+
+
+
+TEST_CASE("indexed scaner produces the same tokens") {
+    char const alphabet[] = "ab  \t\r\n\n[]{}=,\"'#;\x01\xe2";
+    unsigned seed = 777;
+    for(int round = 0; round != 200; ++round) {
+        std::string text;
+        for(int i = 0; i != 300; ++i) {
+            seed = seed * 1103515245u + 12345u;
+            text.push_back(alphabet[(seed >> 16) % (sizeof(alphabet) - 1)]);
+        }
+        text.append(confetti::detail::source_padding, '\0');
+        std::string copy = text;
+
+        using namespace confetti::detail;
+        scaner expected{text.data()};
+        indexed_scaner actual{copy.data()};
+        for(;;) {
+            token const tk = expected.next();
+            REQUIRE_EQ(int(actual.next()), int(tk));
+            REQUIRE_EQ(actual.line_no(), expected.line_no());
+            if(tk == token::text) {
+                REQUIRE_EQ(actual.head() - copy.data(),
+                           expected.head() - text.data());
+                REQUIRE_EQ(actual.text(), expected.text());
+            }
+            if(tk == token::end || tk == token::unclosed_string)
+                break;
+        }
+    }
+}
+
+
+
+TEST_CASE("parse with indexed engine") {
+    char const* const texts[] = {
+        "",
+        "k1 = v1\n[Section]\n# comment\nKey = 'Value' ; comment\n",
+        "data = [\n{k = foo, v = bar},\n{k = bar, v = \"foo\"}]",
+        "k1 = {\n x = 'foo bar', y = [\n1,\n2]\n}\n",
+        "key = 'foo' bar",
+        "k1 = v1\n k1 = v2",
+        "k1 = v1\n\n k2 = ",
+        "[a]\n[b]\n[a]\n",
+        "k = 'unclosed\n",
+        "k = [1, 2\n\n}",
+    };
+    for(char const* text: texts) {
+        confetti::result const expected = confetti::parse_text(text);
+        confetti::result const actual =
+            confetti::parse_text(text, confetti::mode::indexed);
+        REQUIRE_EQ(actual.error_code, expected.error_code);
+        REQUIRE_EQ(actual.line_no, expected.line_no);
+        REQUIRE_EQ(actual.config.size(), expected.config.size());
+    }
+
+    confetti::result const r = confetti::parse_text(
+        "k1 = v1\n[Section]\nKey = 'Value'\ndata = [{k = foo}, 2]\n",
+        confetti::mode::indexed);
+    REQUIRE(r);
+    REQUIRE_EQ(*(r.config["default"]["k1"] | ""), "v1");
+    REQUIRE_EQ(*(r.config["section"]["key"] | ""), "Value");
+    REQUIRE_EQ(*(r.config["section"]["data"][0]["k"] | ""), "foo");
+    REQUIRE_EQ(*(r.config["section"]["data"][1] | 0), 2);
+}
+
+
+
+TEST_CASE("config tree outlives moves of result") {
+    std::string text;
+    for(int i = 0; i != 5000; ++i)
+        text += "k" + std::to_string(i) + " = {x = " + std::to_string(i)
+              + ", y = [" + std::to_string(i) + ", 2]}\n";
+    confetti::result r = confetti::parse_text(text.data());
+    REQUIRE(r);
+    confetti::result moved = std::move(r);
+    auto const& section = moved.config["default"];
+    REQUIRE_EQ(section.size(), 5000);
+    auto const& table = section["k4999"];
+    REQUIRE(table.is_table());
+    REQUIRE_EQ(*(table["x"] | 0), 4999);
+    REQUIRE_EQ(*(table["y"][0] | 0), 4999);
+
+    confetti::value& grown = *moved.config.find("default")->find("k0");
+    for(char const* key: {"a", "b", "c", "d", "e", "f", "g", "h"})
+        REQUIRE(grown.insert(key, confetti::value::make("z")) != nullptr);
+    REQUIRE_EQ(grown.size(), 10);
+    REQUIRE_EQ(*(grown["h"] | ""), "z");
+}
+
+
+
+TEST_CASE("parse big section") {
+    std::string text = "[section]\n";
+    for(int i = 0; i != 100; ++i)
+        text += "key" + std::to_string(i) + " = " + std::to_string(i) + "\n";
+    confetti::result r = confetti::parse_text(text.data());
+    REQUIRE(r);
+    auto& section = *r.config.find("section");
+    REQUIRE_EQ(section.size(), 100);
+    for(int i = 0; i != 100; ++i) {
+        std::string const key = "key" + std::to_string(i);
+        REQUIRE(section.contains(key));
+        REQUIRE_EQ(*(*section.find(key) | -1), i);
+    }
+    REQUIRE_FALSE(section.contains("key100"));
+    REQUIRE(section.insert("key100", confetti::value::make("x")) != nullptr);
+    REQUIRE(section.insert("key42", confetti::value::make("x")) == nullptr);
+
+    text += "key77 = 0\n";
+    r = confetti::parse_text(text.data());
+    REQUIRE_EQ(r.error_code.value(),
+               int(confetti::error::duplicated_parameter));
+    REQUIRE_EQ(r.line_no, 102);
+}
+
+
+
+TEST_CASE("parse nested arrays") {
+    confetti::result r = confetti::parse_text(
+        "data = [[1, 2], [], [[3], {x = [4, 5]}], 6]\n");
+    REQUIRE(r);
+    auto const& data = r.config["default"]["data"];
+    REQUIRE_EQ(data.size(), 4);
+    REQUIRE_EQ(data[0].size(), 2);
+    REQUIRE_EQ(*(data[0][1] | 0), 2);
+    REQUIRE(data[1].is_array());
+    REQUIRE(data[1].empty());
+    REQUIRE_EQ(*(data[2][0][0] | 0), 3);
+    auto const x = data[2][1]["x"] | std::vector<int>{};
+    REQUIRE(x);
+    REQUIRE_EQ(x->size(), 2);
+    REQUIRE_EQ(*(data[3] | 0), 6);
+    REQUIRE(data[4].is_none());
+    REQUIRE(data[0][0][0].is_none());
+}
+
+
+
+TEST_CASE("typed mode converts scalars the same way") {
+    char const* const text =
+        "k0 = true\nk1 = FALSE\nk2 = -5\nk3 = +5\nk4 = 0x1F\n"
+        "k5 = 4294967296\nk6 = 3000000000\nk7 = 1e3\nk8 = abc\nk9 = ''\n"
+        "k10 = ' 1'\nk11 = 18446744073709551615\n"
+        "k12 = -9223372036854775808\nk13 = -3.14E+2\nk14 = 0x\n"
+        "k15 = [1, -2, 3.5]\n";
+    confetti::result const standard = confetti::parse_text(text);
+    confetti::result const typed =
+        confetti::parse_text(text, confetti::mode::typed);
+    REQUIRE(standard);
+    REQUIRE(typed);
+    auto const& expected = standard.config["default"];
+    auto const& actual = typed.config["default"];
+    for(int i = 0; i != 15; ++i) {
+        std::string const key = "k" + std::to_string(i);
+        auto const& e = *const_cast<confetti::value&>(expected).find(key);
+        auto const& a = *const_cast<confetti::value&>(actual).find(key);
+        REQUIRE(a.is_single());
+        REQUIRE_EQ(a | false, e | false);
+        REQUIRE_EQ(a | 0, e | 0);
+        REQUIRE_EQ(a | 0u, e | 0u);
+        REQUIRE_EQ(a | 0ll, e | 0ll);
+        REQUIRE_EQ(a | 0ull, e | 0ull);
+        REQUIRE_EQ(a | 0., e | 0.);
+        REQUIRE_EQ(a | std::string_view{}, e | std::string_view{});
+    }
+    REQUIRE_EQ(*(actual["k0"] | false), true);
+    REQUIRE_EQ(*(actual["k1"] | true), false);
+    REQUIRE_EQ(*(actual["k4"] | 0u), 0x1Fu);
+    REQUIRE_FALSE((actual["k6"] | 0));
+    REQUIRE_EQ(*(actual["k6"] | 0u), 3000000000u);
+    REQUIRE_EQ(*(actual["k13"] | 0.), -314.);
+    REQUIRE_EQ(actual["k15"] | std::vector<double>{},
+               expected["k15"] | std::vector<double>{});
+}
+
+
+
+TEST_CASE("lookup with runtime keys ignores case") {
+    using confetti::detail::fold;
+    for(unsigned c = 0; c != 256; ++c) {
+        std::uint64_t const word = 0x0101010101010101ull * c;
+        std::uint64_t const folded = 0x0101010101010101ull
+            * std::uint8_t(confetti::detail::ascii::lower_case(char(c)));
+        REQUIRE_EQ(fold(word), folded);
+    }
+
+    std::string text = "[Upstreams]\nHost_Name = a\nport = 1\n";
+    for(int i = 0; i != 40; ++i)
+        text += "Parameter_Number_" + std::to_string(i) + " = "
+              + std::to_string(i) + "\n";
+    confetti::result const r = confetti::parse_text(text.data());
+    REQUIRE(r);
+    std::string const section_name = "UPSTREAMS";
+    auto const& section = r.config[section_name];
+    REQUIRE(section.is_table());
+    REQUIRE_EQ(*(section[std::string_view{"HOST_name"}] | ""), "a");
+    REQUIRE_EQ(*(section["Port"] | 0), 1);
+    REQUIRE(section.contains("PORT"));
+    REQUIRE_FALSE(section.contains("ports"));
+    for(int i = 0; i != 40; ++i) {
+        std::string const key = "PARAMETER_number_" + std::to_string(i);
+        REQUIRE_EQ(*(section[key] | -1), i);
+    }
+}
+
+
+
+TEST_CASE("lookup with precomputed keys") {
+    using namespace confetti::literals;
+    static constexpr confetti::key threads{"threads"};
+    static_assert(threads.hash() == confetti::detail::hash("THREADS"));
+    static_assert("threads"_key.hash() == threads.hash());
+
+    confetti::result r = confetti::parse_text(
+        "[Server]\nThreads = 8\nhost = localhost\n");
+    REQUIRE(r);
+    auto const& server = r.config["server"_key];
+    REQUIRE(server.is_table());
+    REQUIRE_EQ(*(server[threads] | 0), 8);
+    REQUIRE_EQ(*(server["Host"_key] | ""), "localhost");
+    REQUIRE(server.contains(threads));
+    REQUIRE_FALSE(server.contains("port"_key));
+    REQUIRE(server["port"_key].is_none());
+    REQUIRE(r.config.find("server"_key)->find(threads) != nullptr);
+}
+
+
+
+struct recorder: confetti::handler {
+    std::string events;
+    std::size_t limit{std::size_t(-1)};
+
+    bool record(std::string const& event) {
+        events += event;
+        events += ' ';
+        return --limit != 0;
+    }
+
+    bool on_section(std::string_view name) {
+        return record("[" + std::string{name} + "]");
+    }
+    bool on_key(std::string_view name) {
+        return record(std::string{name} + "=");
+    }
+    bool on_scalar(std::string_view text) {
+        return record("'" + std::string{text} + "'");
+    }
+    bool on_array_begin() { return record("["); }
+    bool on_array_end() { return record("]"); }
+    bool on_table_begin() { return record("{"); }
+    bool on_table_end() { return record("}"); }
+}; // recorder
+
+
+TEST_CASE("scan reports events in order") {
+    recorder events;
+    confetti::status s = confetti::scan_text(
+        "k1 = v1\n[Section]\n# comment\nKey = 'a b'\n"
+        "data = [{k = foo}, 2, []]\n", events);
+    REQUIRE(s);
+    REQUIRE_FALSE(s.stopped);
+    REQUIRE_EQ(events.events, "k1= 'v1' [Section] Key= 'a b' data= [ { k= "
+                              "'foo' } '2' [ ] ] ");
+
+    recorder first_two;
+    first_two.limit = 2;
+    s = confetti::scan_text("k1 = v1\nk2 = v2\n", first_two);
+    REQUIRE(s);
+    REQUIRE(s.stopped);
+    REQUIRE_EQ(first_two.events, "k1= 'v1' ");
+
+    confetti::handler nothing;
+    REQUIRE(confetti::scan_text(nullptr, nothing));
+    REQUIRE(confetti::scan_text("", nothing));
+}
+
+
+TEST_CASE("scan reports syntax errors like parse") {
+    char const* const texts[] = {
+        "key = 'foo' bar",
+        "k1 = v1\n\n k2 = ",
+        "k = 'unclosed\n",
+        "k = [1, 2\n\n}",
+        "k = {a = 1\n b}",
+        "[section\n",
+        "\n\n=",
+    };
+    for(char const* text: texts) {
+        confetti::handler nothing;
+        confetti::status const actual = confetti::scan_text(text, nothing);
+        confetti::result const expected = confetti::parse_text(text);
+        REQUIRE_FALSE(actual);
+        REQUIRE_EQ(actual.error_code, expected.error_code);
+        REQUIRE_EQ(actual.line_no, expected.line_no);
+    }
+
+    char const* name = "confetti-test-scan.ini";
+    write_file(name, "[Section]\nKey = Value\n");
+    recorder events;
+    REQUIRE(confetti::scan(name, events));
+    REQUIRE_EQ(events.events, "[Section] Key= 'Value' ");
+    std::remove(name);
+    REQUIRE_EQ(confetti::scan(name, events).error_code.value(),
+               int(confetti::error::unable_to_read_file));
+}
+
+
+
+TEST_CASE("push parser accepts source split anywhere") {
+    char const* const texts[] = {
+        "k1 = v1\n[Section]\n# comment\nKey = 'Value' ; tail\n"
+        "data = [{k = foo}, 2]\nlast = word",
+        "key = 'foo' bar",
+        "k1 = v1\n k1 = v2",
+        "k1 = v1\n\n k2 = ",
+        "[a]\n[b]\n[a]\n",
+        "k = 'unclosed\n",
+        "k = [1, 2\n\n}",
+        "[section\n",
+    };
+    for(char const* text: texts) {
+        confetti::result const expected = confetti::parse_text(text);
+        std::string_view const source = text;
+        for(std::size_t split = 0; split <= source.size(); ++split) {
+            confetti::push_parser parser;
+            parser.feed(source.substr(0, split));
+            parser.feed(source.substr(split));
+            confetti::result const actual = parser.finish();
+            REQUIRE_EQ(actual.error_code, expected.error_code);
+            REQUIRE_EQ(actual.line_no, expected.line_no);
+            REQUIRE_EQ(actual.config.size(), expected.config.size());
+        }
+    }
+
+    confetti::push_parser parser;
+    std::string_view const source = texts[0];
+    for(char const c: source)
+        REQUIRE(parser.feed(&c, 1));
+    confetti::result const r = parser.finish();
+    REQUIRE(r);
+    REQUIRE_EQ(*(r.config["default"]["k1"] | ""), "v1");
+    REQUIRE_EQ(*(r.config["section"]["key"] | ""), "Value");
+    REQUIRE_EQ(*(r.config["section"]["data"][0]["k"] | ""), "foo");
+    REQUIRE_EQ(*(r.config["section"]["data"][1] | 0), 2);
+    REQUIRE_EQ(*(r.config["section"]["last"] | ""), "word");
+
+    confetti::push_parser failing;
+    REQUIRE_FALSE(failing.feed("k = = v\n"));
+    REQUIRE_FALSE(failing.feed("x = y\n"));
+    REQUIRE_EQ(failing.finish().error_code.value(),
+               int(confetti::error::invalid_parameter_value));
+
+    REQUIRE(confetti::push_parser{}.finish());
+
+    // Segments stop growing at max_segment_size, statements still cross them
+    std::string big;
+    for(int i = 0; big.size() < 4 * confetti::push_parser::max_segment_size;
+        ++i)
+        big += "key" + std::to_string(i) + " = [" + std::to_string(i)
+             + ", 'some text']\n";
+    confetti::push_parser streamed;
+    for(std::size_t at = 0; at < big.size(); at += 65521)
+        REQUIRE(streamed.feed(std::string_view{big}.substr(at, 65521)));
+    confetti::result const fed = streamed.finish();
+    REQUIRE(fed);
+    confetti::result const whole = confetti::parse_text(big.data());
+    REQUIRE_EQ(fed.config["default"].size(), whole.config["default"].size());
+    REQUIRE(confetti::diff(fed, whole).empty());
+}
+
+
+
+TEST_CASE("push parser scans long statement once") {
+    std::string text = "data = [";
+    for(int i = 0; text.size() < 4 * 1024 * 1024; ++i)
+        text += "[" + std::to_string(i) + ", {k = 'v'}], ";
+
+    std::size_t const before = heap_in_use();
+    confetti::result fed;
+    {
+        confetti::push_parser parser;
+        for(std::size_t at = 0; at < text.size(); at += 4096) {
+            REQUIRE(parser.feed(std::string_view{text}.substr(at, 4096)));
+            // Only pending text is kept until statement ends
+            REQUIRE_LE(heap_in_use() - before, 3 * text.size());
+        }
+        REQUIRE(parser.feed("0]\n"));
+        fed = parser.finish();
+    }
+    REQUIRE(fed);
+    std::size_t const streamed = heap_in_use() - before;
+
+    text += "0]\n";
+    confetti::result const whole = confetti::parse_text(text.data());
+    REQUIRE(whole);
+    REQUIRE_EQ(fed.config["default"]["data"].size(),
+               whole.config["default"]["data"].size());
+    REQUIRE(confetti::diff(fed, whole).empty());
+    REQUIRE_LE(streamed, heap_in_use() - before - streamed + text.size());
+}
+
+
+#if CONFETTI_HAS_MMAP
+TEST_CASE("parse stream of unknown size") {
+    std::FILE* pipe = ::popen("printf '[Section]\\nkey = value\\n'", "r");
+    REQUIRE(pipe != nullptr);
+    confetti::result const r = confetti::parse_stream(pipe);
+    ::pclose(pipe);
+    REQUIRE(r);
+    REQUIRE_EQ(*(r.config["section"]["key"] | ""), "value");
+}
+#endif
+
+
+
+TEST_CASE("parse lazy sections") {
+    char const* const text =
+        "k1 = v1\n[Section]\n# comment\nKey = 'Value' ; tail\n"
+        "data = [\n[1, 2],\n{k = foo}]\n[DEFAULT]\nk2 = v2\n"
+        "[other]\n[broken]\nk = 1\nk = 2\n";
+    confetti::result r = confetti::parse_text(text, confetti::mode::lazy);
+    REQUIRE(r);
+    REQUIRE_EQ(r.config.size(), 4);
+    REQUIRE(r.config.contains("broken"));
+    REQUIRE_EQ(*(r.config["section"]["key"] | ""), "Value");
+    REQUIRE_EQ(*(r.config["section"]["data"][0][1] | 0), 2);
+    REQUIRE_EQ(*(r.config["section"]["data"][1]["k"] | ""), "foo");
+    REQUIRE_EQ(*(r.config["default"]["k1"] | ""), "v1");
+    REQUIRE_EQ(*(r.config["default"]["k2"] | ""), "v2");
+    REQUIRE(r.config["other"].is_table());
+    REQUIRE(r.config["other"].empty());
+    REQUIRE(r);
+    REQUIRE_FALSE(r.deferred_error());
+    REQUIRE(r.config["broken"].is_none());
+    REQUIRE_FALSE(r);
+    confetti::result const standard = confetti::parse_text(text);
+    REQUIRE_EQ(r.deferred_error(), standard.error_code);
+    REQUIRE_EQ(r.deferred_line_no(), standard.line_no);
+    REQUIRE_EQ(r.config.find("section"), &r.config["section"]);
+
+    confetti::result const typed = confetti::parse_text(
+        "[a]\nn = 42\n", confetti::mode::lazy | confetti::mode::typed);
+    REQUIRE_EQ(*(typed.config["a"]["n"] | 0), 42);
+
+    char const* const invalid[] = {
+        "key = 'foo' bar",
+        "k1 = v1\n\n k2 = ",
+        "[a]\n[b]\n[a]\n",
+        "k = 'unclosed\n",
+        "[section\n",
+    };
+    for(char const* text: invalid) {
+        confetti::result const expected = confetti::parse_text(text);
+        confetti::result const actual =
+            confetti::parse_text(text, confetti::mode::lazy);
+        REQUIRE_EQ(actual.error_code, expected.error_code);
+        REQUIRE_EQ(actual.line_no, expected.line_no);
+    }
+}
+
+
+TEST_CASE("lazy sections are parsed once across threads") {
+    std::string text;
+    for(int i = 0; i != 64; ++i)
+        text += "[s" + std::to_string(i) + "]\nk = " + std::to_string(i)
+              + "\n";
+    confetti::result const r =
+        confetti::parse_text(text.data(), confetti::mode::lazy);
+    REQUIRE(r);
+    std::vector<confetti::value const*> seen[4];
+    std::vector<std::thread> threads;
+    for(auto& each: seen)
+        threads.emplace_back([&r, &each] {
+            for(int i = 0; i != 64; ++i)
+                each.push_back(&r.config["s" + std::to_string(i)]);
+        });
+    for(auto& each: threads)
+        each.join();
+    for(int i = 0; i != 64; ++i) {
+        REQUIRE_EQ(*((*seen[0][i])["k"] | -1), i);
+        for(auto const& each: seen)
+            REQUIRE_EQ(each[i], seen[0][i]);
+    }
+}
+
+
+
+static confetti::result parse_in_slices(
+        std::string const& text, std::size_t slices,
+        confetti::mode m = confetti::mode::standard) {
+    namespace detail = confetti::detail;
+    detail::source_ptr source{new char[text.size() + detail::source_padding]};
+    std::memcpy(source.get(), text.data(), text.size());
+    std::memset(source.get() + text.size(), 0, detail::source_padding);
+    return detail::parallel_parser::parse(std::move(source), m, slices);
+}
+
+
+TEST_CASE("sections merged from slices can grow") {
+    std::string text;
+    for(int i = 0; i != 64; ++i)
+        text += "[section" + std::to_string(i) + "]\nkey = 1\n";
+    confetti::result r = parse_in_slices(text, 4);
+    REQUIRE(r);
+    std::vector<std::string> names;
+    for(int i = 0; i != 100; ++i)
+        names.push_back("added" + std::to_string(i));
+    confetti::value* section = r.config.find("section63");
+    REQUIRE(section != nullptr);
+    for(auto const& name: names)
+        REQUIRE(section->insert(name, confetti::value::make("2")) != nullptr);
+    REQUIRE_EQ(section->size(), 101);
+    REQUIRE_EQ(*((*section)["added99"] | 0), 2);
+    REQUIRE_EQ(*((*section)["key"] | 0), 1);
+
+    // Columns make nodes of items in arena of their slice
+    std::string numbers;
+    for(int i = 0; i != 64; ++i)
+        numbers += "[section" + std::to_string(i) + "]\ndata = [1, 2, "
+                 + std::to_string(i) + "]\n";
+    confetti::result columns =
+        parse_in_slices(numbers, 4, confetti::mode::columns);
+    REQUIRE(columns);
+    auto const& data = columns.config["section63"]["data"];
+    REQUIRE_EQ(data.as_span<std::int64_t>().size(), 3);
+    REQUIRE_EQ(*(data[2] | 0), 63);
+}
+
+
+TEST_CASE("parallel parse gives the same config") {
+    std::string text = "k0 = v0\n";
+    for(int i = 0; i != 64; ++i) {
+        text += "[Section" + std::to_string(i) + "]\n";
+        text += "Key = " + std::to_string(i) + "\n";
+        text += "data = [\n[" + std::to_string(i) + "]\n]\n";
+        if(i % 8 == 0)
+            text += "[default]\nk" + std::to_string(i + 1) + " = x\n";
+    }
+    for(std::size_t slices: {1, 2, 3, 7, 16, 100}) {
+        confetti::result const r = parse_in_slices(text, slices);
+        REQUIRE(r);
+        REQUIRE_EQ(r.config.size(), 65);
+        REQUIRE_EQ(r.config["default"].size(), 9);
+        REQUIRE_EQ(*(r.config["default"]["k57"] | ""), "x");
+        for(int i = 0; i != 64; ++i) {
+            auto const& section = r.config["section" + std::to_string(i)];
+            REQUIRE_EQ(*(section["key"] | -1), i);
+            REQUIRE_EQ(*(section["data"][0][0] | -1), i);
+        }
+        int order = -1;
+        for(auto const [name, section]: r.config) {
+            REQUIRE_EQ(name, order == -1 ? std::string{"default"}
+                                         : "section" + std::to_string(order));
+            ++order;
+        }
+    }
+
+    std::string const invalid[] = {
+        text + "[Section3]\n",
+        text + "[default]\nk1 = y\n",
+        text + "k = 'unclosed\n[x]\n",
+        "k = '\n[x]\n'\n[y]\nk = 1\n" + text,
+        text + "[a]\nk = [1,\n[b]\n",
+    };
+    for(auto const& each: invalid) {
+        confetti::result const expected = confetti::parse_text(each.data());
+        for(std::size_t slices: {2, 5, 16}) {
+            confetti::result const actual = parse_in_slices(each, slices);
+            REQUIRE_EQ(actual.error_code, expected.error_code);
+            REQUIRE_EQ(actual.line_no, expected.line_no);
+            REQUIRE_EQ(actual.config.size(), expected.config.size());
+        }
+    }
+
+    confetti::result const r =
+        confetti::parse_text(text.data(), confetti::mode::parallel);
+    REQUIRE(r);
+    REQUIRE_EQ(r.config.size(), 65);
+}
+
+
+
+TEST_CASE("parse many files keeping order") {
+    std::vector<std::string> names;
+    for(int i = 0; i != 20; ++i) {
+        names.push_back("confetti-test-many-" + std::to_string(i) + ".ini");
+        if(i != 7)
+            write_file(names.back().data(),
+                       "[tenant]\nid = " + std::to_string(i) + "\n");
+    }
+    for(unsigned workers: {0, 1, 3, 64}) {
+        std::vector<confetti::result> const parsed =
+            confetti::parse_many(names, confetti::mode::standard, workers);
+        REQUIRE_EQ(parsed.size(), names.size());
+        for(int i = 0; i != 20; ++i) {
+            if(i == 7) {
+                REQUIRE_EQ(parsed[i].error_code.value(),
+                           int(confetti::error::unable_to_read_file));
+                continue;
+            }
+            REQUIRE(parsed[i]);
+            REQUIRE_EQ(*(parsed[i].config["tenant"]["id"] | -1), i);
+        }
+    }
+    for(auto const& name: names)
+        std::remove(name.data());
+    REQUIRE(confetti::parse_many(std::vector<std::string>{}).empty());
+}
+
+
+
+TEST_CASE("parse files asynchronously") {
+    std::vector<std::string> names;
+    for(int i = 0; i != 300; ++i) {
+        names.push_back("confetti-test-async-" + std::to_string(i) + ".ini");
+        if(i % 50 != 7)
+            write_file(names.back().data(),
+                       "[tenant]\nid = " + std::to_string(i) + "\n");
+    }
+    auto check = [](std::vector<confetti::result> const& parsed) {
+        REQUIRE_EQ(parsed.size(), 300);
+        for(int i = 0; i != 300; ++i) {
+            if(i % 50 == 7) {
+                REQUIRE_EQ(parsed[i].error_code.value(),
+                           int(confetti::error::unable_to_read_file));
+                continue;
+            }
+            REQUIRE(parsed[i]);
+            REQUIRE_EQ(*(parsed[i].config["tenant"]["id"] | -1), i);
+        }
+    };
+
+    check(confetti::parse_async(names).get());
+
+    std::vector<confetti::result> parsed(names.size());
+    std::vector<int> calls(names.size(), 0);
+    auto done = [&](std::size_t i, confetti::result&& r) {
+        ++calls[i];
+        parsed[i] = std::move(r);
+    };
+    confetti::parse_each(names, done);
+    check(parsed);
+    confetti::detail::parse_each_on_threads(names, done,
+                                            confetti::mode::standard);
+    check(parsed);
+    for(int each: calls)
+        REQUIRE_EQ(each, 2);
+
+    for(auto const& name: names)
+        std::remove(name.data());
+}
+
+
+
+TEST_CASE("diff reports changed keys") {
+    confetti::result const before = confetti::parse_text(
+        "[server]\n"
+        "host = example.com\n"
+        "ports = [80, 443]\n"
+        "limits = {connections = 100, timeout = 30}\n"
+        "[cache]\n"
+        "size = 64\n");
+    confetti::result const after = confetti::parse_text(
+        "[server]\n"
+        "host = example.com\n"
+        "ports = [80, 8443, 9000]\n"
+        "limits = {connections = 200, timeout = 30, retries = 3}\n"
+        "[logging]\n"
+        "level = debug\n");
+    REQUIRE(before);
+    REQUIRE(after);
+
+    std::vector<confetti::change> const changes = confetti::diff(before, after);
+    REQUIRE_EQ(changes.size(), 6);
+    REQUIRE_EQ(changes[0].path, "server.ports[1]");
+    REQUIRE(changes[0].kind == confetti::change_kind::changed);
+    REQUIRE_EQ(*(*changes[0].before | 0), 443);
+    REQUIRE_EQ(*(*changes[0].after | 0), 8443);
+    REQUIRE_EQ(changes[1].path, "server.ports[2]");
+    REQUIRE(changes[1].kind == confetti::change_kind::added);
+    REQUIRE(changes[1].before == nullptr);
+    REQUIRE_EQ(changes[2].path, "server.limits.connections");
+    REQUIRE(changes[2].kind == confetti::change_kind::changed);
+    REQUIRE_EQ(changes[3].path, "server.limits.retries");
+    REQUIRE(changes[3].kind == confetti::change_kind::added);
+    REQUIRE_EQ(changes[4].path, "cache");
+    REQUIRE(changes[4].kind == confetti::change_kind::removed);
+    REQUIRE(changes[4].before->is_table());
+    REQUIRE(changes[4].after == nullptr);
+    REQUIRE_EQ(changes[5].path, "logging");
+    REQUIRE(changes[5].kind == confetti::change_kind::added);
+
+    REQUIRE(confetti::diff(before, before).empty());
+    REQUIRE_NE(confetti::fingerprint(before), confetti::fingerprint(after));
+}
+
+
+
+TEST_CASE("fingerprint ignores formatting") {
+    char const* text =
+        "top = 1\n"
+        "[a]\n"
+        "x = 1\n"
+        "y = [1, {z = 2}]\n"
+        "[b]\n"
+        "s = 'text'\n";
+    char const* reformatted =
+        "# same content\n"
+        "[B]\n"
+        "s = \"text\"\n"
+        "[default]\n"
+        "top=1\n"
+        "[a]\n"
+        "y = [ 1,\n"
+        "      { z = 2 } ]   ; nested\n"
+        "X = 1\n";
+    confetti::result const parsed = confetti::parse_text(text);
+    std::uint64_t const expected = confetti::fingerprint(parsed);
+    REQUIRE_EQ(confetti::fingerprint(confetti::parse_text(reformatted)),
+               expected);
+    REQUIRE_EQ(confetti::fingerprint(confetti::parse_text(
+                   text, confetti::mode::typed)), expected);
+    REQUIRE_EQ(confetti::fingerprint(confetti::parse_text(
+                   text, confetti::mode::lazy)), expected);
+    REQUIRE(confetti::diff(parsed, confetti::parse_text(reformatted)).empty());
+
+    for(char const* changed: {"top = 1\n[a]\nx = 1\ny = [1, {z = 3}]\n"
+                              "[b]\ns = 'text'\n",
+                              "top = 1\n[a]\nx = 1\ny = [{z = 2}, 1]\n"
+                              "[b]\ns = 'text'\n",
+                              "top = 1\n[a]\nx = 1\ny = [1, {z = 2}]\n"
+                              "[b]\ns = 'Text'\n",
+                              "top = 1\n[a]\nx = 1\n"
+                              "[b]\ns = 'text'\ny = [1, {z = 2}]\n"}) {
+        confetti::result const other = confetti::parse_text(changed);
+        REQUIRE(other);
+        REQUIRE_NE(confetti::fingerprint(other), expected);
+        REQUIRE_FALSE(confetti::diff(parsed, other).empty());
+    }
+}
+
+
+namespace {
+
+    struct server_settings {
+        std::string host{"localhost"};
+        unsigned port{80};
+        bool secure{false};
+        double ratio{1.};
+        float weight{0.f};
+        std::vector<int> ports;
+        std::string_view mode;
+    }; // server_settings
+
+    constexpr confetti::schema server_schema{
+        confetti::field{"host", &server_settings::host},
+        confetti::field{"port", &server_settings::port},
+        confetti::field{"secure", &server_settings::secure},
+        confetti::field{"ratio", &server_settings::ratio},
+        confetti::field{"weight", &server_settings::weight},
+        confetti::field{"ports", &server_settings::ports},
+        confetti::field{"mode", &server_settings::mode}};
+
+} // namespace
+
+
+TEST_CASE("bind section to struct") {
+    confetti::result const parsed = confetti::parse_text(
+        "[server]\n"
+        "Mode = fast\n"
+        "port = 8080\n"
+        "unknown = 1\n"
+        "ports = [1, 2, 3]\n"
+        "secure = TRUE\n"
+        "weight = 0.5\n"
+        "[broken]\n"
+        "port = -1\n"
+        "host = {name = x}\n"
+        "secure = true\n"
+        "ratio = fast\n");
+    REQUIRE(parsed);
+
+    server_settings server;
+    REQUIRE(confetti::bind(parsed.config["server"], server, server_schema)
+                .empty());
+    REQUIRE_EQ(server.host, "localhost");
+    REQUIRE_EQ(server.port, 8080);
+    REQUIRE(server.secure);
+    REQUIRE_EQ(server.ratio, 1.);
+    REQUIRE_EQ(server.weight, 0.5f);
+    REQUIRE_EQ(server.ports, std::vector<int>{1, 2, 3});
+    REQUIRE_EQ(server.mode, "fast");
+
+    server_settings broken;
+    std::vector<confetti::binding_error> const errors =
+        confetti::bind(parsed.config["broken"], broken, server_schema);
+    REQUIRE_EQ(errors.size(), 3);
+    REQUIRE_EQ(errors[0].key, "port");
+    REQUIRE_EQ(errors[1].key, "host");
+    REQUIRE_EQ(errors[2].key, "ratio");
+    REQUIRE_EQ(errors[0].error_code.value(),
+               int(confetti::error::invalid_parameter_value));
+    REQUIRE(broken.secure);
+    REQUIRE_EQ(broken.port, 80);
+
+    server_settings missing;
+    REQUIRE(confetti::bind(parsed.config["missing"], missing, server_schema)
+                .empty());
+    REQUIRE_EQ(confetti::bind(parsed.config["server"]["port"], missing,
+                              server_schema).size(), 1);
+
+    confetti::result const lazy = confetti::parse_text(
+        "[server]\nport = 1\n", confetti::mode::lazy);
+    REQUIRE(confetti::bind(lazy.config["server"], missing, server_schema)
+                .empty());
+    REQUIRE_EQ(missing.port, 1);
+}
+
+
+namespace {
+
+    struct limits_settings {
+        int connections{0};
+        int timeout{0};
+    }; // limits_settings
+
+    struct service_settings {
+        std::string name;
+        std::vector<std::string> tags;
+        limits_settings limits;
+    }; // service_settings
+
+    struct app_settings {
+        unsigned workers{1};
+        server_settings server;
+        service_settings service;
+    }; // app_settings
+
+    constexpr confetti::schema limits_schema{
+        confetti::field{"connections", &limits_settings::connections},
+        confetti::field{"timeout", &limits_settings::timeout}};
+
+    constexpr confetti::schema service_schema{
+        confetti::field{"name", &service_settings::name},
+        confetti::field{"tags", &service_settings::tags},
+        confetti::field{"limits", &service_settings::limits, limits_schema}};
+
+    constexpr confetti::schema app_schema{
+        confetti::field{"workers", &app_settings::workers},
+        confetti::field{"server", &app_settings::server, server_schema},
+        confetti::field{"service", &app_settings::service, service_schema}};
+
+    constexpr confetti::schema file_schema{
+        confetti::field{"workers", &app_settings::workers},
+        confetti::field{"service", &app_settings::service, service_schema}};
+
+} // namespace
+
+
+TEST_CASE("parse into structs by schema") {
+    char const* text =
+        "workers = 4\n"
+        "[server]\n"
+        "port = 8080\n"
+        "mode = fast\n"
+        "ports = [1, 2]\n"
+        "[extra]\n"
+        "anything = {a = [1, {b = 2}]}\n"
+        "[Service]\n"
+        "name = 'billing'\n"
+        "comment = [1, [2, 3], {x = 1}]\n"
+        "tags = [a, 'b c']\n"
+        "limits = {connections = 10, timeout = 5}\n";
+
+    app_settings app;
+    confetti::status const parsed = confetti::parse_text_into(text, app,
+                                                              app_schema);
+    REQUIRE(parsed);
+    REQUIRE_EQ(app.workers, 4);
+    REQUIRE_EQ(app.server.port, 8080);
+    REQUIRE_EQ(app.server.mode, "fast");
+    REQUIRE_EQ(app.server.host, "localhost");
+    REQUIRE_EQ(app.server.ports, std::vector<int>{1, 2});
+    REQUIRE_EQ(app.service.name, "billing");
+    REQUIRE_EQ(app.service.tags, std::vector<std::string>{"a", "b c"});
+    REQUIRE_EQ(app.service.limits.connections, 10);
+    REQUIRE_EQ(app.service.limits.timeout, 5);
+
+    app_settings bound;
+    confetti::result const tree = confetti::parse_text(text);
+    REQUIRE(confetti::bind(tree.config, bound, app_schema).empty());
+    REQUIRE_EQ(bound.server.port, 8080);
+    REQUIRE_EQ(bound.service.limits.timeout, 5);
+
+    confetti::status rejected = confetti::parse_text_into(
+        text, app, app_schema, confetti::unknown_keys::reject);
+    REQUIRE_EQ(rejected.error_code.value(),
+               int(confetti::error::unexpected_section));
+    REQUIRE_EQ(rejected.line_no, 6);
+    rejected = confetti::parse_text_into(
+        "[service]\nlimits = {connections = 1, retries = 2}\n", app,
+        app_schema, confetti::unknown_keys::reject);
+    REQUIRE_EQ(rejected.error_code.value(),
+               int(confetti::error::unexpected_parameter));
+    REQUIRE_EQ(rejected.line_no, 2);
+
+    for(char const* wrong: {"workers = -1\n",
+                            "workers = [1]\n",
+                            "[server]\nports = [1, [2]]\n",
+                            "[service]\nlimits = 1\n",
+                            "[service]\ntags = {a = 1}\n"}) {
+        confetti::status const failed =
+            confetti::parse_text_into(wrong, app, app_schema);
+        REQUIRE_EQ(failed.error_code.value(),
+                   int(confetti::error::invalid_parameter_value));
+        REQUIRE_FALSE(failed.stopped);
+    }
+    REQUIRE_EQ(confetti::parse_text_into("[server\n", app, app_schema)
+                   .error_code.value(),
+               int(confetti::error::invalid_section_name));
+
+    char const* name = "confetti-test-schema.ini";
+    write_file(name, "workers = 2\n[service]\nname = file\n");
+    app_settings loaded;
+    REQUIRE(confetti::parse_into(name, loaded, file_schema));
+    REQUIRE_EQ(loaded.workers, 2);
+    REQUIRE_EQ(loaded.service.name, "file");
+    std::remove(name);
+    REQUIRE_EQ(confetti::parse_into(name, loaded, file_schema)
+                   .error_code.value(),
+               int(confetti::error::unable_to_read_file));
+}
+
+
+TEST_CASE("binary image reads like config") {
+    std::string text =
+        "top = 1\n"
+        "[server]\n"
+        "host = example.com\n"
+        "Port = 8080\n"
+        "ratio = 0.25\n"
+        "ports = [1, 2, 3]\n"
+        "limits = {connections = 10, names = ['a', 'b']}\n"
+        "empty = []\n"
+        "[big]\n";
+    for(int i = 0; i != 100; ++i)
+        text += "key" + std::to_string(i) + " = " + std::to_string(i) + "\n";
+    confetti::result const parsed = confetti::parse_text(text.data());
+    REQUIRE(parsed);
+
+    std::string const bytes = confetti::make_image(parsed, 42);
+    REQUIRE_FALSE(bytes.empty());
+    char const* name = "confetti-test.image";
+    write_file(name, bytes);
+    confetti::image const loaded = confetti::load_image(name);
+    REQUIRE(loaded);
+    REQUIRE_EQ(loaded.source_hash, 42);
+    confetti::image_value const config = loaded.config;
+    REQUIRE(config.is_table());
+    REQUIRE_EQ(config.size(), parsed.config.size());
+    REQUIRE_EQ(*(config["default"]["top"] | 0), 1);
+    confetti::image_value const server = config["SERVER"];
+    REQUIRE_EQ(*(server["host"] | ""), "example.com");
+    REQUIRE_EQ(*(server["port"] | 0), 8080);
+    REQUIRE_EQ(*(server["ratio"] | 0.), 0.25);
+    REQUIRE_EQ(*(server["ports"] | std::vector<int>{}),
+               std::vector<int>{1, 2, 3});
+    REQUIRE_EQ(server["ports"][2] | 0, 3);
+    REQUIRE(server["ports"][3].is_none());
+    REQUIRE_EQ(*(server["limits"]["connections"] | 0), 10);
+    REQUIRE_EQ(*(server["limits"]["names"] | std::vector<std::string>{}),
+               std::vector<std::string>{"a", "b"});
+    REQUIRE(server["empty"].is_array());
+    REQUIRE(server["empty"].empty());
+    REQUIRE_EQ(*(server["missing"] | 7), 7);
+    REQUIRE_FALSE((server["host"] | 0).has_value());
+    REQUIRE_FALSE((server["ports"] | 0).has_value());
+    REQUIRE(server.contains("limits"));
+    REQUIRE_FALSE(server.contains("nothing"));
+    static constexpr confetti::key port{"port"};
+    REQUIRE_EQ(*(server[port] | 0), 8080);
+    for(int i = 0; i != 100; ++i)
+        REQUIRE_EQ(*(config["big"]["KEY" + std::to_string(i)] | -1), i);
+    REQUIRE(config["big"]["key100"].is_none());
+
+    REQUIRE_EQ(confetti::make_image(confetti::parse_text(
+                   text.data(), confetti::mode::lazy), 42), bytes);
+
+    write_file(name, bytes.substr(0, bytes.size() - 1));
+    REQUIRE_EQ(confetti::load_image(name).error_code.value(),
+               int(confetti::error::invalid_image));
+
+    // Damaged image is either rejected or read within its bounds
+    std::function<std::size_t(confetti::image_value)> touch =
+        [&](confetti::image_value v) {
+            std::size_t touched = (v | std::string_view{}).value_or("").size();
+            for(std::size_t i = 0; i != std::min<std::size_t>(v.size(), 8); ++i)
+                touched += touch(v[i]);
+            if(!v.is_table())
+                return touched;
+            for(char const* each: {"default", "server", "big", "host",
+                                   "ports", "limits", "names", "key7"})
+                touched += touch(v[std::string_view{each}]);
+            return touched;
+        };
+    std::size_t rejected = 0;
+    for(std::size_t i = sizeof(confetti::detail::image_header);
+        i != bytes.size(); ++i) {
+        std::string damaged = bytes;
+        damaged[i] = char(damaged[i] ^ (i % 2 == 0 ? 0xFF : 0x80));
+        confetti::image const adopted = confetti::detail::adopt_image(damaged);
+        if(!adopted) {
+            ++rejected;
+            continue;
+        }
+        touch(adopted.config);
+    }
+    REQUIRE_GT(rejected, 0);
+    std::remove(name);
+    REQUIRE_EQ(confetti::load_image(name).error_code.value(),
+               int(confetti::error::unable_to_read_file));
+}
+
+
+
+TEST_CASE("cached image is rebuilt when source changes") {
+    char const* source = "confetti-test-cached.ini";
+    char const* cache = "confetti-test-cached.image";
+    std::remove(cache);
+    write_file(source, "[a]\nx = 1\n");
+
+    confetti::image first = confetti::load_cached(source, cache);
+    REQUIRE(first);
+    REQUIRE_EQ(*(first.config["a"]["x"] | 0), 1);
+    REQUIRE_EQ(first.source_hash, confetti::source_hash("[a]\nx = 1\n"));
+    confetti::image const reused = confetti::load_image(cache);
+    REQUIRE(reused);
+    REQUIRE_EQ(reused.source_hash, first.source_hash);
+
+    write_file(source, "[a]\nx = 2\n");
+    confetti::image const second = confetti::load_cached(source, cache);
+    REQUIRE(second);
+    REQUIRE_EQ(*(second.config["a"]["x"] | 0), 2);
+    REQUIRE_EQ(*(confetti::load_image(cache).config["a"]["x"] | 0), 2);
+    REQUIRE_EQ(*(first.config["a"]["x"] | 0), 1);
+
+    write_file(source, "[a]\nx = 2\n[a]\n");
+    confetti::image const broken = confetti::load_cached(source, cache);
+    REQUIRE_EQ(broken.error_code.value(),
+               int(confetti::error::duplicated_section));
+    REQUIRE_EQ(broken.line_no, 3);
+
+    std::remove(source);
+    std::remove(cache);
+    REQUIRE_EQ(confetti::load_cached(source, cache).error_code.value(),
+               int(confetti::error::unable_to_read_file));
+}
+
+
+TEST_CASE("watcher publishes reparsed snapshots") {
+    char const* name = "confetti-test-watched.ini";
+    write_file(name, "version = 0\n");
+    confetti::watcher watcher{name};
+    auto wait_reloads = [&](std::uint64_t n) {
+        for(int i = 0; i != 500 && watcher.reloads() < n; ++i)
+            std::this_thread::sleep_for(std::chrono::milliseconds{10});
+        REQUIRE_EQ(watcher.reloads(), n);
+    };
+
+    confetti::watcher::snapshot pinned = watcher.current();
+    REQUIRE(*pinned);
+    REQUIRE_EQ(*(pinned.config()["default"]["version"] | -1), 0);
+
+    // More snapshots than reader slots are held by one thread
+    std::vector<confetti::watcher::snapshot> held;
+    for(std::size_t i = 0; i != confetti::watcher::reader_slots + 8; ++i)
+        held.push_back(watcher.current());
+
+    write_file(name, "version = 1\n");
+    wait_reloads(1);
+    REQUIRE_EQ(*(watcher.current().config()["default"]["version"] | -1), 1);
+    REQUIRE_EQ(*(pinned.config()["default"]["version"] | -1), 0);
+    REQUIRE_EQ(*(held.back().config()["default"]["version"] | -1), 0);
+    held.clear();
+    pinned = watcher.current();
+
+    // Failed reparse keeps previous snapshot
+    write_file(name, "version = [1\n");
+    for(int i = 0; i != 500 && !watcher.last_error(); ++i)
+        std::this_thread::sleep_for(std::chrono::milliseconds{10});
+    REQUIRE(watcher.last_error());
+    REQUIRE_EQ(watcher.reloads(), 1);
+
+    std::atomic<bool> done{false};
+    std::atomic<bool> ordered{true};
+    std::vector<std::thread> readers;
+    for(int i = 0; i != 4; ++i)
+        readers.emplace_back([&] {
+            int last = 0;
+            while(!done.load()) {
+                auto const snapshot = watcher.current();
+                int const version =
+                    *(snapshot.config()["default"]["version"] | -1);
+                if(version < last)
+                    ordered.store(false);
+                last = version;
+            }
+        });
+    for(int i = 2; i != 12; ++i) {
+        std::string const next = "version.tmp";
+        write_file(next.data(), "version = " + std::to_string(i) + "\n");
+        std::rename(next.data(), name);
+        wait_reloads(std::uint64_t(i));
+    }
+    done.store(true);
+    for(auto& each: readers)
+        each.join();
+    REQUIRE(ordered.load());
+    REQUIRE_EQ(*(watcher.current().config()["default"]["version"] | -1), 11);
+    REQUIRE_EQ(*(pinned.config()["default"]["version"] | -1), 1);
+    pinned = {};
+    std::remove(name);
+}